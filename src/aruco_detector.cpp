@@ -0,0 +1,267 @@
+#include "aruco_detector.hpp"
+#include "metrics.hpp"
+
+#include <cv_bridge/cv_bridge.h>
+#include <sensor_msgs/image_encodings.h>
+#include <opencv2/highgui.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+
+// Smallest half side of a search region, in pixels
+static const int MIN_ROI_HALF = 48;
+
+// Half side of a search region over the last marker side, room for the motion between frames
+static const float ROI_SCALE = 1.5f;
+
+// Constructor
+ArucoDetector::ArucoDetector(double markerLength, DetectionHandler handler, bool visualize,
+                             CameraPoseProvider cameraPose, int fullFrameInterval)
+    : markerLength(markerLength), handler(handler), visualize(visualize),
+      cameraPose(cameraPose), fullFrameInterval(fullFrameInterval),
+      stopping(false), K(3, 3, CV_64F), D(cv::Mat::zeros(1, 5, CV_64F)), hasCameraInfo(false),
+      processed(0), dropped(0), fullFrames(0), framesSinceFull(0)
+{
+    dictionary = cv::aruco::getPredefinedDictionary(cv::aruco::DICT_6X6_250);
+    parameters = cv::aruco::DetectorParameters::create();
+
+    worker = std::thread(&ArucoDetector::workerLoop, this);
+}
+
+ArucoDetector::~ArucoDetector()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    frameReady.notify_one();
+    worker.join();
+}
+
+void ArucoDetector::imageCallback(const sensor_msgs::ImageConstPtr &msg)
+{
+    Metrics::count(Metrics::FRAMES_RECEIVED);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (pending)
+        {
+            dropped++;
+            Metrics::count(Metrics::FRAMES_DROPPED);
+        }
+        pending = msg;
+    }
+    frameReady.notify_one();
+}
+
+void ArucoDetector::cameraInfoCallback(const sensor_msgs::CameraInfoConstPtr &msg)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Retrive camera matrix and distortion
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            K.at<double>(i, j) = msg->K[i * 3 + j];
+    for (unsigned int i = 0; i < 5 && i < msg->D.size(); i++)
+        D.at<double>(0, i) = msg->D[i];
+    hasCameraInfo = true;
+}
+
+void ArucoDetector::workerLoop()
+{
+    while (true)
+    {
+        sensor_msgs::ImageConstPtr msg;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            frameReady.wait(lock, [this] { return stopping || pending; });
+            if (stopping)
+                return;
+            msg.swap(pending);
+
+            // Intrinsics are copied in buffers of the same size, no allocation after the first frame
+            if (!hasCameraInfo)
+                continue;
+            K.copyTo(workerK);
+            D.copyTo(workerD);
+        }
+
+        detect(msg);
+        processed++;
+    }
+}
+
+// Flips the frame of the message into the flipped buffer, common encodings are converted to BGR8 in the
+// converted buffer; cv_bridge converts the others in a new image
+bool ArucoDetector::loadFrame(const sensor_msgs::ImageConstPtr &msg)
+{
+    namespace enc = sensor_msgs::image_encodings;
+    int code = -1;
+    if (msg->encoding == enc::RGB8)
+        code = cv::COLOR_RGB2BGR;
+    else if (msg->encoding == enc::RGBA8)
+        code = cv::COLOR_RGBA2BGR;
+    else if (msg->encoding == enc::BGRA8)
+        code = cv::COLOR_BGRA2BGR;
+    else if (msg->encoding == enc::MONO8)
+        code = cv::COLOR_GRAY2BGR;
+
+    cv_bridge::CvImageConstPtr image;
+    try
+    {
+        // Shares the message data, no conversion when it is BGR8 or converted below
+        if (code >= 0 || msg->encoding == enc::BGR8)
+            image = cv_bridge::toCvShare(msg);
+        else
+            image = cv_bridge::toCvShare(msg, enc::BGR8);
+    }
+    catch (cv_bridge::Exception &e)
+    {
+        ROS_ERROR("cv_bridge exception: %s", e.what());
+        return false;
+    }
+
+    if (code >= 0)
+    {
+        cv::cvtColor(image->image, converted, code);
+        cv::flip(converted, flipped, 1);
+    }
+    else
+        cv::flip(image->image, flipped, 1);
+    return true;
+}
+
+void ArucoDetector::detect(const sensor_msgs::ImageConstPtr &msg)
+{
+    Metrics::ScopedTimer timer(Metrics::DETECTION_TIME);
+    if (!loadFrame(msg))
+        return;
+
+    // Tracked markers first, the whole frame when the camera pose is unknown, it is time to look
+    // for new markers, or a marker expected in view was not found around its predicted position
+    markers.clear();
+    Eigen::Isometry3d baseToCamera;
+    bool cameraKnown = cameraPose && cameraPose(baseToCamera);
+    bool fullFrame = !cameraKnown || tracks.empty() || framesSinceFull >= fullFrameInterval ||
+                     !detectTracked(baseToCamera);
+    if (fullFrame)
+    {
+        markers.clear();
+        detectRegion(cv::Rect(0, 0, flipped.cols, flipped.rows));
+        framesSinceFull = 0;
+        fullFrames++;
+    }
+    else
+    {
+        framesSinceFull++;
+    }
+
+    if (cameraKnown)
+        updateTracks(baseToCamera, fullFrame);
+
+    Metrics::count(Metrics::MARKERS_DETECTED, markers.size());
+    if (!markers.empty())
+        handler(msg->header.stamp, markers, cameraKnown ? &baseToCamera : nullptr);
+
+    if (visualize)
+    {
+        // draw axis for each marker
+        flipped.copyTo(annotated);
+        for (unsigned int i = 0; i < markers.size(); i++)
+        {
+            cv::aruco::drawDetectedMarkers(annotated, std::vector<std::vector<cv::Point2f>>(1, markers[i].corners), std::vector<int>(1, markers[i].id));
+            cv::aruco::drawAxis(annotated, workerK, workerD, markers[i].rvec, markers[i].tvec, 0.1);
+        }
+        cv::imshow("out", annotated);
+        cv::waitKey(1);
+    }
+}
+
+// Detects the markers inside roi of the flipped frame and appends the ones not found yet
+void ArucoDetector::detectRegion(const cv::Rect &roi)
+{
+    // Aruco detection, on a view of the frame so nothing is copied
+    cv::aruco::detectMarkers(flipped(roi), dictionary, corners, ids, parameters, rejected);
+    if (ids.empty())
+        return;
+
+    for (unsigned int i = 0; i < corners.size(); i++)
+        for (unsigned int k = 0; k < corners[i].size(); k++)
+        {
+            corners[i][k].x += roi.x;
+            corners[i][k].y += roi.y;
+        }
+
+    // Aruco information container
+    cv::aruco::estimatePoseSingleMarkers(corners, markerLength, workerK, workerD, rvecs, tvecs);
+
+    for (unsigned int i = 0; i < ids.size(); i++)
+    {
+        if (isDetected(ids[i]))
+            continue;
+        MarkerDetection marker;
+        marker.id = ids[i];
+        marker.corners = corners[i];
+        marker.rvec = rvecs[i];
+        marker.tvec = tvecs[i];
+        markers.push_back(marker);
+    }
+}
+
+// Searches every tracked marker around its projection, false when one expected in view is missed
+bool ArucoDetector::detectTracked(const Eigen::Isometry3d &baseToCamera)
+{
+    Eigen::Isometry3d cameraToBase = baseToCamera.inverse();
+    double fx = workerK.at<double>(0, 0), cx = workerK.at<double>(0, 2);
+    double fy = workerK.at<double>(1, 1), cy = workerK.at<double>(1, 2);
+    cv::Rect frame(0, 0, flipped.cols, flipped.rows);
+
+    for (std::map<int, Track>::const_iterator it = tracks.begin(); it != tracks.end(); ++it)
+    {
+        Eigen::Vector3d p = cameraToBase * it->second.position;
+        if (p.z() <= markerLength)
+            continue; // behind or too close to the camera
+
+        // The frame is flipped horizontally, so the marker is seen at -x (see addToTf)
+        double u = -fx * p.x() / p.z() + cx;
+        double v = fy * p.y() / p.z() + cy;
+        int half = std::max(MIN_ROI_HALF, (int)(ROI_SCALE * it->second.size));
+        cv::Rect roi = cv::Rect((int)u - half, (int)v - half, 2 * half, 2 * half) & frame;
+        if (roi.area() == 0)
+            continue; // out of view
+
+        if (!isDetected(it->first))
+            detectRegion(roi);
+        if (!isDetected(it->first))
+            return false;
+    }
+    return true;
+}
+
+void ArucoDetector::updateTracks(const Eigen::Isometry3d &baseToCamera, bool fullFrame)
+{
+    // A full frame search sees every marker in view, the others are dropped
+    if (fullFrame)
+        tracks.clear();
+
+    for (unsigned int i = 0; i < markers.size(); i++)
+    {
+        const MarkerDetection &marker = markers[i];
+        Track &track = tracks[marker.id];
+        track.position = baseToCamera * Eigen::Vector3d(-marker.tvec[0], marker.tvec[1], marker.tvec[2]);
+        track.size = (float)(cv::arcLength(marker.corners, true) / 4);
+    }
+}
+
+bool ArucoDetector::isDetected(int id) const
+{
+    for (unsigned int i = 0; i < markers.size(); i++)
+        if (markers[i].id == id)
+            return true;
+    return false;
+}
+
+// GETTERS
+
+unsigned long ArucoDetector::getProcessedFrames() const { return processed; }
+unsigned long ArucoDetector::getDroppedFrames() const { return dropped; }
+unsigned long ArucoDetector::getFullFrames() const { return fullFrames; }
@@ -0,0 +1,119 @@
+#ifndef ARUCO_DETECTOR
+#define ARUCO_DETECTOR
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <ros/ros.h>
+#include "sensor_msgs/Image.h"
+#include "sensor_msgs/CameraInfo.h"
+
+#include <opencv2/core.hpp>
+#include <opencv2/aruco.hpp>
+
+#include <Eigen/Geometry>
+
+// Marker found in a frame, pose in the camera optical frame (image flipped horizontally)
+struct MarkerDetection
+{
+    int id;
+    std::vector<cv::Point2f> corners;
+    cv::Vec3d rvec;
+    cv::Vec3d tvec;
+};
+
+//CLASS TO DETECT ARUCO MARKERS OUT OF THE ROS CALLBACKS
+//the image callback only stores the newest frame, a worker thread runs the detection on it;
+//frames arriving while the worker is busy replace the stored one, so it never lags behind the camera.
+//When the camera pose is known, markers already seen are searched only in a region around the point
+//where they are expected, with a full frame search every few frames or when one of them is missed
+class ArucoDetector
+{
+public:
+    // Called from the worker thread with all the markers of a frame, and the camera pose when it is known
+    typedef std::function<void(const ros::Time &stamp, const std::vector<MarkerDetection> &markers, const Eigen::Isometry3d *baseToCamera)> DetectionHandler;
+
+    // Pose of the (not flipped) camera optical frame in the robot base frame, false when unknown
+    typedef std::function<bool(Eigen::Isometry3d &baseToCamera)> CameraPoseProvider;
+
+private:
+    // Marker seen in the last frames
+    struct Track
+    {
+        Eigen::Vector3d position; // center, base frame
+        float size;               // side in pixels
+    };
+
+    double markerLength;
+    DetectionHandler handler;
+    bool visualize;
+    CameraPoseProvider cameraPose;
+    int fullFrameInterval;
+
+    // Built once, reused for every frame
+    cv::Ptr<cv::aruco::Dictionary> dictionary;
+    cv::Ptr<cv::aruco::DetectorParameters> parameters;
+
+    // Latest frame wins single slot
+    std::mutex mutex;
+    std::condition_variable frameReady;
+    sensor_msgs::ImageConstPtr pending;
+    bool stopping;
+
+    // Camera intrinsics, written by the camera info callback
+    cv::Mat K;
+    cv::Mat D;
+    bool hasCameraInfo;
+
+    std::atomic<unsigned long> processed;
+    std::atomic<unsigned long> dropped;
+    std::atomic<unsigned long> fullFrames;
+
+    // Worker buffers, reallocated only when the image size changes. The callback keeps only the message and the
+    // worker is done with a frame before it takes the next, so one buffer per stage is the whole pool
+    cv::Mat converted; // non BGR8 frames
+    cv::Mat flipped;
+    cv::Mat annotated;
+    cv::Mat workerK, workerD;
+    std::vector<int> ids;
+    std::vector<std::vector<cv::Point2f>> corners, rejected;
+    std::vector<cv::Vec3d> rvecs, tvecs;
+    std::vector<MarkerDetection> markers;
+
+    // Worker only
+    std::map<int, Track> tracks;
+    int framesSinceFull;
+
+    std::thread worker; // last, started once everything else is built
+
+    void workerLoop();
+    bool loadFrame(const sensor_msgs::ImageConstPtr &msg);
+    void detect(const sensor_msgs::ImageConstPtr &msg);
+    void detectRegion(const cv::Rect &roi);
+    bool detectTracked(const Eigen::Isometry3d &baseToCamera);
+    void updateTracks(const Eigen::Isometry3d &baseToCamera, bool fullFrame);
+    bool isDetected(int id) const;
+
+public:
+    // Constructor, markerLength in meters; visualize shows the annotated frames in a window.
+    // Without a camera pose provider every frame is searched in full
+    ArucoDetector(double markerLength, DetectionHandler handler, bool visualize = false,
+                  CameraPoseProvider cameraPose = CameraPoseProvider(), int fullFrameInterval = 10);
+    ~ArucoDetector();
+
+    // ROS callbacks
+    void imageCallback(const sensor_msgs::ImageConstPtr &msg);
+    void cameraInfoCallback(const sensor_msgs::CameraInfoConstPtr &msg);
+
+    // Statistics
+    unsigned long getProcessedFrames() const;
+    unsigned long getDroppedFrames() const;
+    unsigned long getFullFrames() const;
+};
+
+#endif
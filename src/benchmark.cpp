@@ -0,0 +1,447 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cstdlib>
+#include <algorithm>
+#include <string>
+#include <vector>
+#define _USE_MATH_DEFINES // For PI costants
+#include <cmath>
+#include <Eigen/Eigen>
+
+#include <tf/transform_broadcaster.h>
+
+#include "kdl_kinematics.hpp"
+#include "cartesian_trajectory.hpp"
+#include "quintic_timing_law.hpp"
+#include "joint_pol_traj.hpp"
+#include "ur5_batch_fk.hpp"
+
+// PI costants
+#define PI M_PI    // pi
+#define PI2 M_PI_2 // pi/2
+
+using namespace Eigen;
+
+typedef std::chrono::steady_clock Clock;
+
+//latency of repeated runs of the same operation, reported as percentiles to track regressions
+class Latency
+{
+private:
+    std::string name;
+    std::vector<double> samples; // [us]
+
+public:
+    explicit Latency(const std::string &name) : name(name) {}
+
+    void add(Clock::time_point start)
+    {
+        samples.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    }
+
+    double percentile(double p)
+    {
+        std::sort(samples.begin(), samples.end());
+        return samples[std::min(samples.size() - 1, (size_t)(p / 100 * samples.size()))];
+    }
+
+    void report()
+    {
+        // percentile() sorts the samples, so everything is read before streaming
+        double p50 = percentile(50), p90 = percentile(90), p99 = percentile(99), max = samples.back();
+        std::cout << name << ": p50 " << p50 << " us, p90 " << p90 << " us, p99 " << p99
+                  << " us, max " << max << " us (" << samples.size() << " runs)" << std::endl;
+    }
+};
+
+//discards what the timed code prints, restoring std::cout when it goes out of scope
+class QuietOutput
+{
+private:
+    std::streambuf *buffer;
+
+public:
+    QuietOutput() : buffer(std::cout.rdbuf(NULL)) {}
+    ~QuietOutput()
+    {
+        std::cout.rdbuf(buffer);
+        std::cout.clear();
+    }
+};
+
+// Pose of the end effector, as the positions and RPY angles hard-coded in the task
+struct Pose
+{
+    const char *name;
+    Vector3d p, PHI;
+};
+
+//inverse kinematics building every solver at each call, as RobotArm::IKinematics used to do
+static KDL::JntArray legacyIKinematics(const KDL::Chain &chain, double X, double Y, double Z, double roll, double pitch, double yaw, double joints[6], const TrajectoryMatrix &operational_velocities, int pos)
+{
+    KDL::ChainFkSolverPos_recursive fk = KDL::ChainFkSolverPos_recursive(chain);
+    unsigned int nj = chain.getNrOfJoints();
+    KDL::JntArray jointpositions = KDL::JntArray(nj);
+    for (unsigned int i = 0; i < nj; i++)
+        jointpositions(i) = joints[i == 0 ? 2 : (i == 2 ? 0 : i)];
+
+    KDL::ChainIkSolverVel_wdls ik_v = KDL::ChainIkSolverVel_wdls(chain);
+    KDL::ChainIkSolverPos_LMA ik_p = KDL::ChainIkSolverPos_LMA(chain);
+
+    tf::Quaternion q1;
+    q1.setEuler(yaw, pitch, roll);
+    tf::Matrix3x3 m_new1(q1.normalize());
+    KDL::Rotation R1 = KDL::Rotation(m_new1[0][0], m_new1[0][1], m_new1[0][2], m_new1[1][0],
+                                     m_new1[1][1], m_new1[1][2], m_new1[2][0], m_new1[2][1], m_new1[2][2]);
+    KDL::Frame target = KDL::Frame(R1, KDL::Vector(X, Y, Z));
+
+    KDL::JntArray target_joints = KDL::JntArray(nj);
+    KDL::JntArray target_joints_vel = KDL::JntArray(nj);
+    ik_p.CartToJnt(jointpositions, target, target_joints);
+
+    KDL::Twist tw = KDL::Twist::Zero();
+    tw.vel.x(operational_velocities.coeff(0, pos));
+    tw.vel.y(operational_velocities.coeff(1, pos));
+    tw.vel.z(operational_velocities.coeff(2, pos));
+    tw.rot.x(operational_velocities.coeff(3, pos));
+    tw.rot.y(operational_velocities.coeff(4, pos));
+    tw.rot.z(operational_velocities.coeff(5, pos));
+    ik_v.CartToJnt(target_joints, tw, target_joints_vel);
+
+    return target_joints;
+}
+
+//per-sample IK cost, solvers built on every call against the persistent ones of RobotArm
+static void benchmarkIKinematics(RobotArm &ra, CartesianTrajectory &trajectory, const CartesianTrajectory &lazyTrajectory, const CartesianTrajectory &slerpTrajectory,
+                                 double joints[6], int rounds)
+{
+    int length = trajectory.get_length();
+    double vel_[6], acc_[6];
+
+    Clock::time_point start = Clock::now();
+    for (int r = 0; r < rounds; r++)
+        for (int i = 0; i < length; i++)
+            legacyIKinematics(ra.getChain(),
+                              trajectory.dataPosition.coeff(0, i), trajectory.dataPosition.coeff(1, i), trajectory.dataPosition.coeff(2, i),
+                              trajectory.dataPosition.coeff(3, i), trajectory.dataPosition.coeff(4, i), trajectory.dataPosition.coeff(5, i),
+                              joints, trajectory.dataVelocities, i);
+    double legacy = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / (rounds * length);
+
+    start = Clock::now();
+    for (int r = 0; r < rounds; r++)
+        for (int i = 0; i < length; i++)
+            ra.IKinematics(trajectory.dataPosition.coeff(0, i), trajectory.dataPosition.coeff(1, i), trajectory.dataPosition.coeff(2, i),
+                           trajectory.dataPosition.coeff(3, i), trajectory.dataPosition.coeff(4, i), trajectory.dataPosition.coeff(5, i),
+                           joints, trajectory.dataVelocities, i, trajectory.dataAcceleration, length, vel_, acc_);
+    double persistent = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / (rounds * length);
+
+    start = Clock::now();
+    for (int r = 0; r < rounds; r++)
+        ra.solveTrajectory(trajectory, joints);
+    double batch = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / (rounds * length);
+
+    TrajectoryMatrix jointPos, jointVel, jointAcc;
+    start = Clock::now();
+    for (int r = 0; r < rounds; r++)
+        ra.solveTrajectory(trajectory, joints, jointPos, jointVel, jointAcc);
+    double derivatives = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / (rounds * length);
+
+    start = Clock::now();
+    for (int r = 0; r < rounds; r++)
+        ra.solveTrajectory(lazyTrajectory, joints);
+    double lazy = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / (rounds * length);
+
+    start = Clock::now();
+    for (int r = 0; r < rounds; r++)
+        ra.solveTrajectory(slerpTrajectory, joints);
+    double slerp = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / (rounds * length);
+
+    start = Clock::now();
+    for (int r = 0; r < rounds; r++)
+        ra.solveTrajectoryParallel(trajectory, joints);
+    double parallel = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / (rounds * length);
+
+    std::cout << "IK per sample, solvers built per call: " << legacy << " us" << std::endl;
+    std::cout << "IK per sample, persistent solvers:     " << persistent << " us" << std::endl;
+    std::cout << "IK per sample, warm started batch:     " << batch << " us" << std::endl;
+    std::cout << "IK per sample, with velocity and acc.: " << derivatives << " us" << std::endl;
+    std::cout << "IK per sample, lazy streamed batch:    " << lazy << " us" << std::endl;
+    std::cout << "IK per sample, lazy SLERP orientation: " << slerp << " us" << std::endl;
+    std::cout << "IK per sample, parallel segments:      " << parallel << " us (" << std::thread::hardware_concurrency() << " cores)" << std::endl;
+
+    if (ra.setIKBackend(RobotArm::IK_ANALYTIC))
+    {
+        start = Clock::now();
+        for (int r = 0; r < rounds; r++)
+            ra.solveTrajectory(trajectory, joints);
+        double analytic = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / (rounds * length);
+        ra.setIKBackend(RobotArm::IK_LMA);
+
+        std::cout << "IK per sample, analytic UR5 batch:     " << analytic << " us" << std::endl;
+    }
+}
+
+//cost of the time optimal law of the move and the time it saves against the fixed duration one
+static void benchmarkTimeOptimal(RobotArm &ra, const CartesianTrajectory &trajectory, double joints[6], int rounds)
+{
+    const int points = 100;
+    JointLimits limits = JointLimits::UR5();
+
+    Clock::time_point start = Clock::now();
+    MatrixXd path;
+    for (int r = 0; r < rounds; r++)
+        path = ra.solvePath(trajectory, points, joints);
+    double solve = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / rounds;
+
+    double duration = 0;
+    start = Clock::now();
+    for (int r = 0; r < rounds; r++)
+        duration = PathTimingLaw(path, limits).getDuration();
+    double timing = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / rounds;
+
+    std::cout << "Time optimal law, " << points << " path points: IK " << solve << " us, timing law " << timing << " us" << std::endl;
+    std::cout << "Time optimal move: " << duration << " s instead of " << trajectory.getDuration() << " s" << std::endl;
+}
+
+//forward kinematics of many random configurations, one KDL chain walk each against the batched kernel;
+//the error is the largest difference of a position or rotation entry from the KDL pose
+static void benchmarkBatchFK(RobotArm &ra, int rounds)
+{
+    const UR5Kinematics *model = ra.getAnalyticModel();
+    if (model == NULL)
+    {
+        std::cout << "Batch FK skipped, the chain is not a UR5" << std::endl;
+        return;
+    }
+
+    const int n = 100000;
+    UR5BatchFK::JointBatch q = PI * UR5BatchFK::JointBatch::Random(n, 6);
+    UR5BatchFK::PositionBatch positions;
+    UR5BatchFK::RotationBatch rotations;
+    std::vector<KDL::Frame> frames(n);
+
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < n; i++)
+    {
+        //joint_states order
+        double joints[6] = {q(i, 2), q(i, 1), q(i, 0), q(i, 3), q(i, 4), q(i, 5)};
+        frames[i] = ra.FKinematics(joints);
+    }
+    double kdl = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / n;
+    std::cout << "FK per configuration, KDL chain:    " << kdl << " ns" << std::endl;
+
+    UR5BatchFK fk(*model);
+    const char *NAMES[3] = {"scalar", "AVX2", "AVX-512"};
+    for (int b = UR5BatchFK::SCALAR; b <= UR5BatchFK::AVX512; b++)
+    {
+        if (!fk.setBackend((UR5BatchFK::Backend)b))
+            continue;
+
+        start = Clock::now();
+        for (int r = 0; r < rounds; r++)
+            fk.forward(q, positions, rotations);
+        double batch = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / ((double)rounds * n);
+
+        double error = 0;
+        for (int i = 0; i < n; i++)
+            for (int r = 0; r < 3; r++)
+            {
+                error = std::max(error, std::fabs(frames[i].p(r) - positions(i, r)));
+                for (int k = 0; k < 3; k++)
+                    error = std::max(error, std::fabs(frames[i].M(r, k) - rotations(i, r * 3 + k)));
+            }
+        std::cout << "FK per configuration, batch " << NAMES[b] << ": " << batch << " ns, max error " << error << std::endl;
+    }
+}
+
+//latency of the single calls the task makes for every move
+static void benchmarkCalls(RobotArm &ra, const std::vector<Pose> &poses, double joints[6], int rounds)
+{
+    static const TrajectoryMatrix REST = TrajectoryMatrix::Zero(6, 1);
+    const Pose &home = poses.front();
+    double vel_[6], acc_[6];
+
+    Latency cartesian("CartesianTrajectory, eager 4 s at 0.1 s"), lazy("CartesianTrajectory, lazy"),
+        joint("JointPolTraj, 4 s at 0.1 s"), fk("RobotArm::FKinematics"), ik("RobotArm::IKinematics");
+    for (int r = 0; r < rounds; r++)
+    {
+        for (unsigned int k = 1; k < poses.size(); k++)
+        {
+            const Pose &cube = poses[k];
+            QuietOutput quiet;
+
+            Clock::time_point start = Clock::now();
+            CartesianTrajectory eagerTrajectory(home.p, cube.p, home.PHI, cube.PHI, 0, 4, 0.1);
+            cartesian.add(start);
+
+            start = Clock::now();
+            CartesianTrajectory lazyTrajectory(home.p, cube.p, home.PHI, cube.PHI, 0, 4, 0.1, CartesianTrajectory::LAZY);
+            lazy.add(start);
+
+            start = Clock::now();
+            JointPolTraj jointTrajectory(home.p, cube.p, home.PHI, cube.PHI, ra, joints, 6, 0, 4, 0.1);
+            joint.add(start);
+
+            start = Clock::now();
+            ra.FKinematics(joints);
+            fk.add(start);
+
+            start = Clock::now();
+            ra.IKinematics(cube.p(0), cube.p(1), cube.p(2), cube.PHI(0), cube.PHI(1), cube.PHI(2), joints, REST, 0, REST, 0, vel_, acc_);
+            ik.add(start);
+        }
+    }
+
+    cartesian.report();
+    lazy.report();
+    joint.report();
+    fk.report();
+    ik.report();
+}
+
+//whole IK loop of the moves from home to every cube detection point, as the task runs them
+static void benchmarkMoves(RobotArm &ra, const std::vector<Pose> &poses, double joints[6], int rounds)
+{
+    const Pose &home = poses.front();
+    for (unsigned int k = 1; k < poses.size(); k++)
+    {
+        const Pose &cube = poses[k];
+        Latency move(std::string("Move home to ") + cube.name + ", IK of every sample");
+        for (int r = 0; r < rounds; r++)
+        {
+            QuietOutput quiet;
+            Clock::time_point start = Clock::now();
+            CartesianTrajectory trajectory(home.p, cube.p, home.PHI, cube.PHI, 0, 4, 0.1, CartesianTrajectory::LAZY);
+            ra.solveTrajectory(trajectory, joints);
+            move.add(start);
+        }
+        move.report();
+    }
+}
+
+//quintic polynomials for every joint, inverting the boundary conditions matrix and calling pow() as before
+static void legacyFifthPolTraj(MatrixXd &jointPos, MatrixXd &jointVel, MatrixXd &jointAcc, double *qi, double *qf, int nJoints, int samples, double deltaT, double Ts)
+{
+    MatrixXd H(6, 6);
+    H << 1, 0, 0, 0, 0, 0,
+        0, 1, 0, 0, 0, 0,
+        0, 0, 2, 0, 0, 0,
+        1, deltaT, pow(deltaT, 2), pow(deltaT, 3), pow(deltaT, 4), pow(deltaT, 5),
+        0, 1, 2 * deltaT, 3 * pow(deltaT, 2), 4 * pow(deltaT, 3), 5 * pow(deltaT, 4),
+        0, 0, 2, 6 * deltaT, 12 * pow(deltaT, 2), 20 * pow(deltaT, 3);
+
+    for (int j = 0; j < nJoints; j++)
+    {
+        MatrixXd Q(6, 1);
+        Q << qi[j], 0, 0, qf[j], 0, 0;
+        MatrixXd a = H.inverse() * (Q);
+        for (int i = 0; i < samples; i++)
+        {
+            double t = i * Ts;
+            jointPos(j, i) = a(5) * pow(t, 5) + a(4) * pow(t, 4) + a(3) * pow(t, 3) + a(2) * pow(t, 2) + a(1) * t + a(0);
+            jointVel(j, i) = 5 * a(5) * pow(t, 4) + 4 * a(4) * pow(t, 3) + 3 * a(3) * pow(t, 2) + 2 * a(2) * t + a(1);
+            jointAcc(j, i) = 20 * a(5) * pow(t, 3) + 12 * a(4) * pow(t, 2) + 6 * a(3) * t + 2 * a(2);
+        }
+    }
+}
+
+//cost of a 6 joints quintic trajectory, matrix inverse and pow() against the closed form with Horner's scheme
+static void benchmarkTimingLaw(int rounds)
+{
+    const int nJoints = 6;
+    const double Ts = 0.001, deltaT = 4;
+    int samples = 1 + (int)floor(deltaT / Ts);
+    double qi[nJoints] = {0, -PI2, 0, 0, 0, 0};
+    double qf[nJoints] = {1.2, -1.0, 0.8, -1.5, -PI2, 0.5};
+    TrajectoryMatrix pos(nJoints, samples), vel(nJoints, samples), acc(nJoints, samples);
+    MatrixXd legacyPos(nJoints, samples), legacyVel(nJoints, samples), legacyAcc(nJoints, samples);
+
+    Clock::time_point start = Clock::now();
+    for (int r = 0; r < rounds; r++)
+        legacyFifthPolTraj(legacyPos, legacyVel, legacyAcc, qi, qf, nJoints, samples, deltaT, Ts);
+    double legacy = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / rounds;
+
+    VectorXd zero = VectorXd::Zero(nJoints);
+    start = Clock::now();
+    for (int r = 0; r < rounds; r++)
+    {
+        QuinticTimingLaw law(Map<VectorXd>(qi, nJoints), Map<VectorXd>(qf, nJoints), zero, zero, zero, zero, deltaT);
+        law.evaluate(samples, Ts, pos, vel, acc);
+    }
+    double horner = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / rounds;
+
+    double error = std::max((pos - legacyPos).cwiseAbs().maxCoeff(),
+                            std::max((vel - legacyVel).cwiseAbs().maxCoeff(), (acc - legacyAcc).cwiseAbs().maxCoeff()));
+
+    std::cout << "Quintic, " << nJoints << " joints x " << samples << " samples, inverse and pow(): " << legacy << " us" << std::endl;
+    std::cout << "Quintic, " << nJoints << " joints x " << samples << " samples, closed form Horner: " << horner << " us"
+              << " (x" << legacy / horner << ", max difference " << error << ")" << std::endl;
+}
+
+/**
+ * MAIN
+ */
+int main(int argc, char **argv)
+{
+    int rounds = argc > 2 ? atoi(argv[2]) : 20;
+    benchmarkTimingLaw(rounds);
+
+    //kinematics benchmarks need the robot model
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <robot.urdf> [rounds]" << std::endl;
+        return 1;
+    }
+
+    std::ifstream urdf(argv[1]);
+    if (!urdf)
+    {
+        std::cerr << "Cannot open " << argv[1] << std::endl;
+        return 1;
+    }
+    std::stringstream robot_desc;
+    robot_desc << urdf.rdbuf();
+
+    RobotArm ra(robot_desc.str());
+
+    //home to blue cube detection point, as in the task
+    Vector3d pi, pf, PHI_i, PHI_f;
+    pi << 0.077, -0.161, 1.123;
+    PHI_i << 0, -PI, -PI2;
+    pf << 0.80, 0.318, 0.750;
+    PHI_f << 0, -PI, -0.7;
+    CartesianTrajectory trajectory(pi, pf, PHI_i, PHI_f, 0, 4, 0.1);
+    CartesianTrajectory lazyTrajectory(pi, pf, PHI_i, PHI_f, 0, 4, 0.1, CartesianTrajectory::LAZY);
+    CartesianTrajectory slerpTrajectory(pi, pf, PHI_i, PHI_f, 0, 4, 0.1, CartesianTrajectory::LAZY, CartesianTrajectory::SLERP);
+
+    //vertical configuration, joint_states order
+    double joints[6] = {0, -PI2, 0, 0, 0, 0};
+
+    benchmarkIKinematics(ra, trajectory, lazyTrajectory, slerpTrajectory, joints, rounds);
+    benchmarkTimeOptimal(ra, trajectory, joints, rounds);
+    benchmarkBatchFK(ra, rounds);
+
+    //home and the cube detection points of the task
+    std::vector<Pose> poses(5);
+    poses[0].name = "home";
+    poses[0].p << 0.077, -0.161, 1.123;
+    poses[0].PHI << 0, -PI, -PI2;
+    poses[1].name = "blue cube";
+    poses[1].p << 0.80, 0.318, 0.750;
+    poses[1].PHI << 0, -PI, -0.7;
+    poses[2].name = "green cube";
+    poses[2].p << 0.65, 0.218, 0.613;
+    poses[2].PHI << 0, -PI, -1.311;
+    poses[3].name = "red cube";
+    poses[3].p << 0.65, -0.473, 0.613;
+    poses[3].PHI << 0, -PI, -1.311;
+    poses[4].name = "yellow cube";
+    poses[4].p << 0.739, -0.166, 0.727;
+    poses[4].PHI << 0, -PI, -0.7;
+
+    benchmarkCalls(ra, poses, joints, rounds);
+    benchmarkMoves(ra, poses, joints, rounds);
+    return 0;
+}
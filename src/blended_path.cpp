@@ -0,0 +1,124 @@
+#include "blended_path.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Waypoints closer than this are the same one
+static const double WAYPOINT_EPS = 1e-9;
+
+// Constructor
+BlendedPath::BlendedPath(const WaypointList &waypoints, double maxDeviation, double rotationWeight)
+    : rotationWeight(rotationWeight), length(0), start(waypoints.front())
+{
+    // Distinct consecutive waypoints only, a corner needs two legs of non zero length
+    WaypointList corners;
+    corners.push_back(waypoints.front());
+    for (unsigned int i = 1; i < waypoints.size(); i++)
+        if (distance(waypoints[i] - corners.back()) > WAYPOINT_EPS)
+            corners.push_back(waypoints[i]);
+
+    // Distance from every inner corner at which its blend starts and ends
+    int n = corners.size();
+    std::vector<double> d(n, 0.0);
+    for (int k = 1; k < n - 1; k++)
+    {
+        double lenIn = distance(corners[k] - corners[k - 1]);
+        double lenOut = distance(corners[k + 1] - corners[k]);
+        Vector6d uIn = (corners[k] - corners[k - 1]) / lenIn;
+        Vector6d uOut = (corners[k + 1] - corners[k]) / lenOut;
+
+        // The middle of the blend is the point farthest from the corner, at d |uOut - uIn| / 4
+        double turn = distance(uOut - uIn);
+        if (turn > WAYPOINT_EPS)
+            d[k] = std::min(4 * maxDeviation / turn, 0.5 * std::min(lenIn, lenOut));
+    }
+
+    // Segments shortened by the blends at their ends, blends in between
+    for (int k = 0; k < n - 1; k++)
+    {
+        Vector6d u = (corners[k + 1] - corners[k]) / distance(corners[k + 1] - corners[k]);
+        Vector6d from = corners[k] + d[k] * u;
+        Vector6d to = corners[k + 1] - d[k + 1] * u;
+        addSegment(from, to);
+
+        if (d[k + 1] > 0)
+        {
+            Piece blend;
+            blend.begin = length;
+            blend.length = 2 * d[k + 1];
+            blend.blend = true;
+            blend.p0 = to;
+            blend.p1 = corners[k + 1];
+            blend.p2 = corners[k + 1] + d[k + 1] * (corners[k + 2] - corners[k + 1]) / distance(corners[k + 2] - corners[k + 1]);
+            pieces.push_back(blend);
+            length += blend.length;
+        }
+    }
+}
+
+void BlendedPath::addSegment(const Vector6d &from, const Vector6d &to)
+{
+    double segmentLength = distance(to - from);
+    if (segmentLength <= WAYPOINT_EPS)
+        return;
+
+    Piece segment;
+    segment.begin = length;
+    segment.length = segmentLength;
+    segment.blend = false;
+    segment.p0 = from;
+    segment.p1 = from; // unused by segments
+    segment.p2 = to;
+    pieces.push_back(segment);
+    length += segmentLength;
+}
+
+double BlendedPath::distance(const Vector6d &v) const
+{
+    return std::sqrt(v.head<3>().squaredNorm() + rotationWeight * rotationWeight * v.tail<3>().squaredNorm());
+}
+
+void BlendedPath::evaluate(double s, Vector6d &pose, Vector6d &dpose, Vector6d &ddpose) const
+{
+    if (pieces.empty())
+    {
+        pose = start;
+        dpose.setZero();
+        ddpose.setZero();
+        return;
+    }
+
+    // Piece containing the distance, by bisection on the piece starts
+    double l = std::min(std::max(s, 0.0), 1.0) * length;
+    int i = 0, last = pieces.size() - 1;
+    while (i < last)
+    {
+        int mid = (i + last + 1) / 2;
+        if (pieces[mid].begin <= l)
+            i = mid;
+        else
+            last = mid - 1;
+    }
+    const Piece &piece = pieces[i];
+
+    // Local parameter of the piece, and its derivative with respect to s
+    double u = std::min((l - piece.begin) / piece.length, 1.0);
+    double du = length / piece.length;
+
+    if (!piece.blend)
+    {
+        pose = piece.p0 + u * (piece.p2 - piece.p0);
+        dpose = du * (piece.p2 - piece.p0);
+        ddpose.setZero();
+        return;
+    }
+
+    pose = (1 - u) * (1 - u) * piece.p0 + 2 * u * (1 - u) * piece.p1 + u * u * piece.p2;
+    dpose = du * 2 * ((1 - u) * (piece.p1 - piece.p0) + u * (piece.p2 - piece.p1));
+    ddpose = du * du * 2 * (piece.p0 - 2 * piece.p1 + piece.p2);
+}
+
+// GETTERS
+
+double BlendedPath::getLength() const { return length; }
+int BlendedPath::getPieces() const { return pieces.size(); }
@@ -0,0 +1,53 @@
+#ifndef BLENDED_PATH
+#define BLENDED_PATH
+
+#include <Eigen/Eigen>
+#include <Eigen/StdVector>
+
+#include <vector>
+
+#include "trajectory_types.hpp"
+
+// End effector poses (position, RPY angles) a path goes through
+typedef std::vector<Vector6d, Eigen::aligned_allocator<Vector6d>> WaypointList;
+
+//CLASS FOR OPERATIONAL SPACE PATHS THROUGH WAYPOINTS
+//straight segments between the waypoints, every inner corner replaced by a quadratic Bezier blend
+//that passes at most maxDeviation from it; distances weigh the RPY angles by rotationWeight [m/rad].
+//The path is parametrized by s in [0, 1], proportional to the distance along the segments, and a blend
+//takes the same share of s as the two corner legs it replaces, so the derivative of the pose with
+//respect to s is continuous: a timing law needs no stop at the blended corners
+class BlendedPath
+{
+private:
+    struct Piece
+    {
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        double begin;  // distance along the path at the start of the piece
+        double length; // share of the path distance
+        bool blend;
+        Vector6d p0, p1, p2; // segment from p0 to p2, or Bezier control points
+    };
+
+    std::vector<Piece, Eigen::aligned_allocator<Piece>> pieces;
+    double rotationWeight;
+    double length;
+    Vector6d start;
+
+    double distance(const Vector6d &v) const;
+    void addSegment(const Vector6d &from, const Vector6d &to);
+
+public:
+    // Constructor, at least one waypoint; repeated waypoints are skipped
+    BlendedPath(const WaypointList &waypoints, double maxDeviation, double rotationWeight = 0.1);
+
+    // Pose at the abscissa s, clamped to [0, 1], with its first and second derivative with respect to s
+    void evaluate(double s, Vector6d &pose, Vector6d &dpose, Vector6d &ddpose) const;
+
+    // Getters
+    double getLength() const;
+    int getPieces() const;
+};
+
+#endif
@@ -1,7 +1,9 @@
 #include "cartesian_trajectory.hpp"
+#include "metrics.hpp"
 
 #include <iostream>
 #include <cmath>
+#include <algorithm>
 #include <Eigen/Eigen>
 #include <Eigen/Dense>
 #include <Eigen/Geometry>
@@ -11,32 +13,16 @@ using namespace Eigen;
 
 // PUBLIC METHODS
 
-CartesianTrajectory::CartesianTrajectory(MatrixXd pi, MatrixXd pf, MatrixXd PHI_i, MatrixXd PHI_f, double ti, double tf, double Ts)
+CartesianTrajectory::CartesianTrajectory(const Vector3d &pi, const Vector3d &pf, const Vector3d &PHI_i, const Vector3d &PHI_f, double ti, double tf, double Ts,
+                                         Evaluation evaluation, OrientationPath orientationPath)
+    : evaluation(evaluation), Ts(Ts), pi(pi), dp(pf - pi), PHI_i(PHI_i), dPHI(PHI_f - PHI_i), orientationPath(orientationPath),
+      law(0, 1, 0, 0, 0, 0, tf - ti)
 {
     length = (int)floor((tf - ti) / Ts);
-    
-    // Build data matrices
-    std::cout << "Initializing trajectory matrices..." << std::endl;
-    dataPosition = MatrixXd(6, length);
-    dataVelocities = MatrixXd(6, length);
-    dataAcceleration = MatrixXd(6, length);
-
-    MatrixXd T(1, length);
-    MatrixXd q(1, length);
-    MatrixXd qd(1, length);
-    MatrixXd qdd(1, length);
-
-    //fifth_polinomials(T,q,qd,qdd,ti, tf, qi, dqi, ddqi, qf, dqf, ddqf, Ts);
-
-    // Position in operationalspace with TIMING LAW
-    MatrixXd p_tilde(3, length);
-    MatrixXd dp_tilde(3, length);
-    MatrixXd ddp_tilde(3, length);
-
-    std::cout << "Lineat trajectory computation..." << std::endl;
-    linear_tilde(T, p_tilde, dp_tilde, ddp_tilde, pi, pf, ti, tf, Ts);
-    // std::cout << p_tilde << std::endl;
-    //// std::cout<< "Linear_tilde: " << p_tilde << "\n" << std::endl;
+    initSlerp();
+
+    if (evaluation == EAGER)
+        fillData();
 
     // int length2 = circular_length(pi, pf, Ts, c);
     // MatrixXd p_tilde1(3, length);
@@ -96,136 +82,287 @@ CartesianTrajectory::CartesianTrajectory(MatrixXd pi, MatrixXd pf, MatrixXd PHI_
     //frenet_frame(p, dp, ddp, o_EE_t, o_EE_n, o_EE_b, PHI_i, PHI_f, length1);
     // frenet_frame(p, dp, ddp, o_EE_t, o_EE_n, o_EE_b, PHI_i, PHI_f, length1);
 
-    // EE_orientation with the TIMING LAW
-    std::cout << "Initializing orientation matrices..." << std::endl;
-    MatrixXd o_tilde(3, length);
-    MatrixXd do_tilde(3, length);
-    MatrixXd ddo_tilde(3, length);
-    EE_orientation(T, PHI_i, PHI_f, o_tilde, do_tilde, ddo_tilde, pi, pf, ti, tf, Ts);
-    // std::cout << "o_tilde" << o_tilde << std::endl;
+}
+
+CartesianTrajectory::CartesianTrajectory(const Vector3d &pi, const Vector3d &pf, const Vector3d &PHI_i, const Vector3d &PHI_f, std::shared_ptr<const PathTimingLaw> optimalLaw, double Ts,
+                                         Evaluation evaluation, OrientationPath orientationPath)
+    : evaluation(evaluation), Ts(Ts), pi(pi), dp(pf - pi), PHI_i(PHI_i), dPHI(PHI_f - PHI_i), orientationPath(orientationPath),
+      law(0, 1, 0, 0, 0, 0, optimalLaw->getDuration()), optimalLaw(optimalLaw)
+{
+    // Samples up to the first one at or after the end, which sample() clamps to the end
+    length = 1 + (int)ceil(optimalLaw->getDuration() / Ts);
+    initSlerp();
 
-    // Put the 3d coordinate togheter
-    std::cout << "Initializing position, velocity and acceleration matrices..." << std::endl;
-    dataPosition.block(0, 0, 3, length) = p_tilde.block(0, 0, 3, length);
-    dataPosition.block(3, 0, 3, length) = o_tilde.block(0, 0, 3, length);
+    if (evaluation == EAGER)
+        fillData();
+}
 
-    dataVelocities.block(0, 0, 3, length) = dp_tilde.block(0, 0, 3, length);
-    dataVelocities.block(3, 0, 3, length) = do_tilde.block(0, 0, 3, length);
+CartesianTrajectory::CartesianTrajectory(std::shared_ptr<const BlendedPath> path, double ti, double tf, double Ts, Evaluation evaluation)
+    : evaluation(evaluation), Ts(Ts), pi(Vector3d::Zero()), dp(Vector3d::Zero()), PHI_i(Vector3d::Zero()), dPHI(Vector3d::Zero()), orientationPath(RPY_LINEAR),
+      law(0, 1, 0, 0, 0, 0, tf - ti), path(path)
+{
+    length = (int)floor((tf - ti) / Ts);
 
-    dataAcceleration.block(0, 0, 3, length) = ddp_tilde.block(0, 0, 3, length);
-    dataAcceleration.block(3, 0, 3, length) = ddo_tilde.block(0, 0, 3, length);
+    if (evaluation == EAGER)
+        fillData();
 }
 
-int CartesianTrajectory::get_length()
+CartesianTrajectory::CartesianTrajectory(std::shared_ptr<const BlendedPath> path, std::shared_ptr<const PathTimingLaw> optimalLaw, double Ts, Evaluation evaluation)
+    : evaluation(evaluation), Ts(Ts), pi(Vector3d::Zero()), dp(Vector3d::Zero()), PHI_i(Vector3d::Zero()), dPHI(Vector3d::Zero()), orientationPath(RPY_LINEAR),
+      law(0, 1, 0, 0, 0, 0, optimalLaw->getDuration()), optimalLaw(optimalLaw), path(path)
+{
+    length = 1 + (int)ceil(optimalLaw->getDuration() / Ts);
+
+    if (evaluation == EAGER)
+        fillData();
+}
+
+CartesianSample CartesianTrajectory::sample(double t) const
+{
+    Metrics::ScopedTimer timer(Metrics::TRAJECTORY_SAMPLE_TIME);
+    CartesianSample current;
+    current.t = std::min(std::max(t, 0.0), getDuration());
+
+    double s, sd, sdd;
+    evaluateLaw(current.t, s, sd, sdd);
+    path_tilde(s, sd, sdd, current);
+    return current;
+}
+
+CartesianSample CartesianTrajectory::pathSample(double s) const
+{
+    CartesianSample current;
+    current.t = 0;
+    path_tilde(s, 1, 0, current);
+    return current;
+}
+
+CartesianSample CartesianTrajectory::sampleAt(int i) const
+{
+    if (evaluation == LAZY)
+        return sample(i * Ts);
+
+    CartesianSample current;
+    current.t = i * Ts;
+    current.position = dataPosition.col(i);
+    current.velocity = dataVelocities.col(i);
+    current.acceleration = dataAcceleration.col(i);
+    if (orientationPath == SLERP)
+    {
+        current.slerp = true;
+        current.orientation = slerpOrientation(current.position.tail<3>());
+    }
+    return current;
+}
+
+CartesianTrajectory::const_iterator CartesianTrajectory::begin() const
+{
+    return const_iterator(*this, 0);
+}
+
+CartesianTrajectory::const_iterator CartesianTrajectory::end() const
+{
+    return const_iterator(*this, length);
+}
+
+int CartesianTrajectory::get_length() const
 {
     return length;
 }
 
-// PRIVATE METHODS
+double CartesianTrajectory::getTs() const
+{
+    return Ts;
+}
 
-void CartesianTrajectory::linear_tilde(MatrixXd &T, MatrixXd &p_tilde, MatrixXd &dp_tilde, MatrixXd &ddp_tilde, MatrixXd &pi, MatrixXd &pf, double ti, double tf, double Ts)
+double CartesianTrajectory::getDuration() const
 {
+    return optimalLaw ? optimalLaw->getDuration() : law.getDuration();
+}
 
-    double qi = 0;
-    double dqi = 0;
-    double ddqi = 0;
-    MatrixXd support = pf - pi;
-    double qf = (double)support.norm();
-    double dqf = 0;
-    double ddqf = 0;
+CartesianTrajectory::Evaluation CartesianTrajectory::getEvaluation() const
+{
+    return evaluation;
+}
 
-    // int length = (int)floor((tf - ti) / Ts);
-    MatrixXd s(1, length);
-    MatrixXd sd(1, length);
-    MatrixXd sdd(1, length);
+CartesianTrajectory::OrientationPath CartesianTrajectory::getOrientationPath() const
+{
+    return orientationPath;
+}
 
-    CartesianTrajectory::fifth_polinomials(T, s, sd, sdd, ti, tf, qi, dqi, ddqi, qf, dqf, ddqf, Ts);
+Quaterniond CartesianTrajectory::rpyToQuaternion(const Vector3d &PHI)
+{
+    return Quaterniond(AngleAxisd(PHI(2), Vector3d::UnitY()) * AngleAxisd(PHI(1), Vector3d::UnitX()) * AngleAxisd(PHI(0), Vector3d::UnitZ()));
+}
 
-    for (int i = 0; i < length; i++)
-    {
-        p_tilde.col(i) = pi + (support / support.norm()) * s.col(i);
-        dp_tilde.col(i) = ((support) / support.norm()) * sd.col(i);
-        ddp_tilde.col(i) = ((support) / support.norm()) * sdd.col(i);
-    }
+// ITERATOR
+
+CartesianTrajectory::const_iterator::const_iterator(const CartesianTrajectory &trajectory, int index)
+    : trajectory(&trajectory), index(index)
+{
+    if (index < trajectory.length)
+        current = trajectory.sampleAt(index);
 }
 
-void CartesianTrajectory::fifth_polinomials(MatrixXd &T, MatrixXd &q, MatrixXd &qd, MatrixXd &qdd, double ti, double tf, double qi, double dqi, double ddqi, double qf, double dqf, double ddqf, double Ts)
+CartesianTrajectory::const_iterator::reference CartesianTrajectory::const_iterator::operator*() const
 {
-    double deltaT = tf-ti;
-    MatrixXd H(6, 6);
-    H << 1, 0, 0, 0, 0, 0,
-        0, 1, 0, 0, 0, 0,
-        0, 0, 2, 0, 0, 0,
-        1, deltaT, pow(deltaT, 2), pow(deltaT, 3), pow(deltaT, 4), pow(deltaT, 5),
-        0, 1, 2 * deltaT, 3 * pow(deltaT, 2), 4 * pow(deltaT, 3), 5 * pow(deltaT, 4),
-        0, 0, 2, 6 * deltaT, 12 * pow(deltaT, 2), 20 * pow(deltaT, 3);
+    return current;
+}
 
-    MatrixXd Q(6, 1);
-    Q << qi,
-        dqi,
-        ddqi,
-        qf,
-        dqf,
-        ddqf;
+CartesianTrajectory::const_iterator::pointer CartesianTrajectory::const_iterator::operator->() const
+{
+    return &current;
+}
 
-    MatrixXd a = H.inverse() * (Q);
+CartesianTrajectory::const_iterator &CartesianTrajectory::const_iterator::operator++()
+{
+    if (++index < trajectory->length)
+        current = trajectory->sampleAt(index);
+    return *this;
+}
 
-    MatrixXd a0 = a.row(0);
-    MatrixXd a1 = a.row(1);
-    MatrixXd a2 = a.row(2);
-    MatrixXd a3 = a.row(3);
-    MatrixXd a4 = a.row(4);
-    MatrixXd a5 = a.row(5);
+CartesianTrajectory::const_iterator CartesianTrajectory::const_iterator::operator++(int)
+{
+    const_iterator previous = *this;
+    ++(*this);
+    return previous;
+}
 
-    // int length = (int)floor((tf - ti) / Ts);
-    // int count = 0;
-    // for (double i = ti; i < length; i += Ts)
-    // {
-    //     if (count >= length)
-    //     {
-    //         break;
-    //     }
-    //     T(0, count) = i;
-    //     count++;
-    // }
-
-    // std::cout << "A coeff fifth polynomials: " << a0.coeff(0, 0) << " " << a1.coeff(0, 0) << " " << a2.coeff(0, 0) << " " << a3.coeff(0, 0) << " " << a4.coeff(0, 0) << " " << a5.coeff(0, 0) << "\n"
-    // << std::endl;
-    for (int i = 0; i < length; i++)
+bool CartesianTrajectory::const_iterator::operator==(const const_iterator &other) const
+{
+    return trajectory == other.trajectory && index == other.index;
+}
+
+bool CartesianTrajectory::const_iterator::operator!=(const const_iterator &other) const
+{
+    return !(*this == other);
+}
+
+// PRIVATE METHODS
+
+void CartesianTrajectory::fillData()
+{
+    // Build data matrices, the timing law is evaluated over the whole time grid before filling them
+    dataPosition.resize(6, length);
+    dataVelocities.resize(6, length);
+    dataAcceleration.resize(6, length);
+
+    RowVectorXd s, sd, sdd;
+    if (optimalLaw)
+    {
+        s.resize(length);
+        sd.resize(length);
+        sdd.resize(length);
+        for (int i = 0; i < length; i++)
+            optimalLaw->evaluate(std::min(i * Ts, getDuration()), s(i), sd(i), sdd(i));
+    }
+    else
+        law.evaluate(length, Ts, s, sd, sdd);
+
+    if (path)
+    {
+        Vector6d pose, dpose, ddpose;
+        for (int i = 0; i < length; i++)
+        {
+            path->evaluate(s(i), pose, dpose, ddpose);
+            dataPosition.col(i) = pose;
+            dataVelocities.col(i) = dpose * sd(i);
+            dataAcceleration.col(i) = ddpose * (sd(i) * sd(i)) + dpose * sdd(i);
+        }
+        return;
+    }
+
+    // Straight line, and orientation along dPHI from PHI_i or along the SLERP rotation vector from zero
+    Vector3d orientationStart = orientationPath == SLERP ? Vector3d::Zero() : PHI_i;
+    Vector3d orientationDisplacement = orientationPath == SLERP ? rotation : dPHI;
+    dataPosition.topRows<3>() = (dp * s).colwise() + pi;
+    dataVelocities.topRows<3>() = dp * sd;
+    dataAcceleration.topRows<3>() = dp * sdd;
+    dataPosition.bottomRows<3>() = (orientationDisplacement * s).colwise() + orientationStart;
+    dataVelocities.bottomRows<3>() = orientationDisplacement * sd;
+    dataAcceleration.bottomRows<3>() = orientationDisplacement * sdd;
+}
+
+void CartesianTrajectory::evaluateLaw(double t, double &s, double &sd, double &sdd) const
+{
+    if (optimalLaw)
+        optimalLaw->evaluate(t, s, sd, sdd);
+    else
+        law.evaluate(t, 0, s, sd, sdd);
+}
+
+void CartesianTrajectory::path_tilde(double s, double sd, double sdd, CartesianSample &sample) const
+{
+    if (!path)
     {
-        double t = i*Ts;
-        q(0, i) = a5.coeff(0, 0) * pow(t, 5) + a4.coeff(0, 0) * pow(t, 4) + a3.coeff(0, 0) * pow(t, 3) + a2.coeff(0, 0) * pow(t, 2) + a1.coeff(0, 0) * pow(t, 1) + a0.coeff(0, 0);
-        qd(0, i) = 5 * a5.coeff(0, 0) * pow(t, 4) + 4 * a4.coeff(0, 0) * pow(t, 3) + 3 * a3.coeff(0, 0) * pow(t, 2) + 2 * a2.coeff(0, 0) * pow(t, 1) + a1.coeff(0, 0);
-        qdd(0, i) = 20 * a5.coeff(0, 0) * pow(t, 3) + 12 * a4.coeff(0, 0) * pow(t, 2) + 6 * a3.coeff(0, 0) * pow(t, 1) + 2 * a2.coeff(0, 0);
+        linear_tilde(s, sd, sdd, sample);
+        if (orientationPath == SLERP)
+            EE_slerp(s, sd, sdd, sample);
+        else
+            EE_orientation(s, sd, sdd, sample);
+        return;
     }
+
+    // Chain rule on the waypoint path, its derivatives are with respect to s
+    Vector6d dpose, ddpose;
+    path->evaluate(s, sample.position, dpose, ddpose);
+    sample.velocity = dpose * sd;
+    sample.acceleration = ddpose * (sd * sd) + dpose * sdd;
+}
+
+void CartesianTrajectory::linear_tilde(double s, double sd, double sdd, CartesianSample &sample) const
+{
+    // Straight line from pi, s is the normalized abscissa
+    sample.position.head<3>() = pi + dp * s;
+    sample.velocity.head<3>() = dp * sd;
+    sample.acceleration.head<3>() = dp * sdd;
 }
 
-void CartesianTrajectory::EE_orientation(MatrixXd &T, MatrixXd &PHI_i, MatrixXd &PHI_f, MatrixXd &o_tilde, MatrixXd &do_tilde, MatrixXd &ddo_tilde, MatrixXd &pi, MatrixXd &pf, double ti, double tf, double Ts)
+void CartesianTrajectory::fifth_polinomials(MatrixXd &q, MatrixXd &qd, MatrixXd &qdd, double ti, double tf, double qi, double dqi, double ddqi, double qf, double dqf, double ddqf, double Ts)
+{
+    QuinticTimingLaw law(qi, qf, dqi, dqf, ddqi, ddqf, tf - ti);
+    law.evaluate(length, Ts, q, qd, qdd);
+}
+
+void CartesianTrajectory::EE_orientation(double s, double sd, double sdd, CartesianSample &sample) const
 {
 
     // @todo understand how to deal with nan orientations, (consider them as infinity or use the PHI_i)
-    double qi = 0;
-    double dqi = 0;
-    double ddqi = 0;
-    MatrixXd support = PHI_f - PHI_i;
-    double qf = support.norm();
-    double dqf = 0;
-    double ddqf = 0;
+    sample.position.tail<3>() = PHI_i + dPHI * s;
+    sample.velocity.tail<3>() = dPHI * sd;
+    sample.acceleration.tail<3>() = dPHI * sdd;
+}
 
-    // int length = (int)floor((tf - ti) / Ts);
-    MatrixXd s(1, length);
-    MatrixXd sd(1, length);
-    MatrixXd sdd(1, length);
+void CartesianTrajectory::initSlerp()
+{
+    if (orientationPath != SLERP)
+        return;
+
+    // Shortest of the two rotations, the quaternions q and -q being the same orientation
+    qi = rpyToQuaternion(PHI_i);
+    Quaterniond dq = rpyToQuaternion(PHI_i + dPHI) * qi.conjugate();
+    if (dq.w() < 0)
+        dq.coeffs() = -dq.coeffs();
+    AngleAxisd displacement(dq);
+    rotation = displacement.angle() * displacement.axis();
+}
 
-    CartesianTrajectory::fifth_polinomials(T, s, sd, sdd, ti, tf, qi, dqi, ddqi, qf, dqf, ddqf, Ts);
+void CartesianTrajectory::EE_slerp(double s, double sd, double sdd, CartesianSample &sample) const
+{
+    // R(s) = exp(s [rotation]) Ri: the axis is fixed, so the angular velocity and acceleration are along it
+    sample.position.tail<3>() = rotation * s;
+    sample.velocity.tail<3>() = rotation * sd;
+    sample.acceleration.tail<3>() = rotation * sdd;
+    sample.slerp = true;
+    sample.orientation = slerpOrientation(sample.position.tail<3>());
+}
 
-    MatrixXd l =  support.norm() == 0 ? support : support / support.norm();
-    for (int i = 0; i < length; i++)
-    {
-        o_tilde.col(i) = PHI_i + l * s.col(i);
-        do_tilde.col(i) = l * sd.col(i);
-        ddo_tilde.col(i) = l * sdd.col(i);
-    }
+Quaterniond CartesianTrajectory::slerpOrientation(const Vector3d &rotationVector) const
+{
+    double angle = rotationVector.norm();
+    if (angle == 0)
+        return qi;
+    return AngleAxisd(angle, rotationVector / angle) * qi;
 }
 
 //all methods below are not used
@@ -388,7 +525,7 @@ void CartesianTrajectory::circular_tilde(MatrixXd &T, MatrixXd &p_tilde, MatrixX
     MatrixXd sd(1, length);
     MatrixXd sdd(1, length);
 
-    CartesianTrajectory::fifth_polinomials(T, s, sd, sdd, ti, tf, qi, dqi, ddqi, qf, dqf, ddqf, Ts);
+    CartesianTrajectory::fifth_polinomials(s, sd, sdd, ti, tf, qi, dqi, ddqi, qf, dqf, ddqf, Ts);
 
     MatrixXd p_prime(3, length);
 
@@ -6,14 +6,73 @@
 #include <Eigen/Geometry>
 #include <Eigen/Eigenvalues>
 
+#include "trajectory_types.hpp"
+#include "quintic_timing_law.hpp"
+#include "path_timing_law.hpp"
+#include "blended_path.hpp"
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+
 using namespace Eigen;
+
+// Pose (position, RPY angles), twist and acceleration of the end effector at one instant
+struct CartesianSample
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    CartesianSample() : t(0), slerp(false) {}
+
+    double t; // from the start of the move
+    Vector6d position;
+    Vector6d velocity;
+    Vector6d acceleration;
+
+    // SLERP orientation path: the orientation is given here, and the last three rows of position, velocity and
+    // acceleration are the rotation vector from the start orientation and its derivatives, the angular velocity
+    // and acceleration in the base frame
+    bool slerp;
+    Quaterniond orientation;
+};
+
 //CLASS TO BUILD CARTESIAN TRAJECTORY
 class CartesianTrajectory
 {
+public:
+    enum Evaluation
+    {
+        EAGER, // every sample is computed in the constructor and stored in the data matrices
+        LAZY   // data matrices stay empty, samples are computed on demand in constant memory
+    };
+
+    enum OrientationPath
+    {
+        RPY_LINEAR, // RPY angles interpolated linearly
+        SLERP       // shortest rotation between the end orientations, about a fixed axis
+    };
+
 private:
-    void linear_tilde(MatrixXd &T, MatrixXd &p_tilde, MatrixXd &dp_tilde, MatrixXd &ddp_tilde, MatrixXd &pi, MatrixXd &pf, double ti, double tf, double Ts);
-    void fifth_polinomials(MatrixXd &T, MatrixXd &q, MatrixXd &qd, MatrixXd &qdd, double ti, double tf, double qi, double dqi, double ddqi, double qf, double dqf, double ddqf, double Ts);
-    void EE_orientation(MatrixXd &T, MatrixXd &PHI_i, MatrixXd &PHI_f, MatrixXd &o_tilde, MatrixXd &do_tilde, MatrixXd &ddo_tilde, MatrixXd &pi, MatrixXd &pf, double ti, double tf, double Ts);
+    Evaluation evaluation;
+    double Ts;
+    Vector3d pi, dp;        // start and displacement of the position
+    Vector3d PHI_i, dPHI;   // start and displacement of the orientation
+    OrientationPath orientationPath;
+    Quaterniond qi;         // SLERP start orientation
+    Vector3d rotation;      // SLERP rotation vector from the start to the end orientation, base frame
+    QuinticTimingLaw law;   // normalized from 0 to 1, shared by position and orientation
+    std::shared_ptr<const PathTimingLaw> optimalLaw; // replaces law when set
+    std::shared_ptr<const BlendedPath> path;          // replaces the straight line when set
+
+    void fillData();
+    void evaluateLaw(double t, double &s, double &sd, double &sdd) const;
+    void path_tilde(double s, double sd, double sdd, CartesianSample &sample) const;
+    void linear_tilde(double s, double sd, double sdd, CartesianSample &sample) const;
+    void fifth_polinomials(MatrixXd &q, MatrixXd &qd, MatrixXd &qdd, double ti, double tf, double qi, double dqi, double ddqi, double qf, double dqf, double ddqf, double Ts);
+    void EE_orientation(double s, double sd, double sdd, CartesianSample &sample) const;
+    void initSlerp();
+    void EE_slerp(double s, double sd, double sdd, CartesianSample &sample) const;
+    Quaterniond slerpOrientation(const Vector3d &rotationVector) const;
     //all methods below are not used
     double sign_func(double x);
     double vecangle(Vector3d &v1, Vector3d &v2, Vector3d &normal);
@@ -26,14 +85,67 @@ private:
 public:
     // Properties
     // Declaration of data matrices
-    MatrixXd dataPosition;     // (6, length);
-    MatrixXd dataVelocities;   // (6, length);
-    MatrixXd dataAcceleration; // (6, length);
+    TrajectoryMatrix dataPosition;     // (6, length);
+    TrajectoryMatrix dataVelocities;   // (6, length);
+    TrajectoryMatrix dataAcceleration; // (6, length);
     int length;
 
-    CartesianTrajectory(MatrixXd pi, MatrixXd pf, MatrixXd PHI_i, MatrixXd PHI_f, double ti, double tf, double Ts);
+    // Forward iterator over the samples, each one is computed when the iterator reaches it
+    class const_iterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef CartesianSample value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const CartesianSample *pointer;
+        typedef const CartesianSample &reference;
+
+        const_iterator(const CartesianTrajectory &trajectory, int index);
+
+        reference operator*() const;
+        pointer operator->() const;
+        const_iterator &operator++();
+        const_iterator operator++(int);
+        bool operator==(const const_iterator &other) const;
+        bool operator!=(const const_iterator &other) const;
+
+    private:
+        const CartesianTrajectory *trajectory;
+        int index;
+        CartesianSample current;
+    };
+
+    CartesianTrajectory(const Vector3d &pi, const Vector3d &pf, const Vector3d &PHI_i, const Vector3d &PHI_f, double ti, double tf, double Ts,
+                        Evaluation evaluation = EAGER, OrientationPath orientationPath = RPY_LINEAR);
+
+    // Same path timed by a time optimal law (see RobotArm::solvePath), the last sample is the end at rest
+    CartesianTrajectory(const Vector3d &pi, const Vector3d &pf, const Vector3d &PHI_i, const Vector3d &PHI_f, std::shared_ptr<const PathTimingLaw> optimalLaw, double Ts,
+                        Evaluation evaluation = EAGER, OrientationPath orientationPath = RPY_LINEAR);
+
+    // Path through waypoints, timed from ti to tf or by a time optimal law; waypoint orientations are RPY angles
+    CartesianTrajectory(std::shared_ptr<const BlendedPath> path, double ti, double tf, double Ts, Evaluation evaluation = EAGER);
+    CartesianTrajectory(std::shared_ptr<const BlendedPath> path, std::shared_ptr<const PathTimingLaw> optimalLaw, double Ts, Evaluation evaluation = EAGER);
+
+    // Pose at the abscissa s in [0, 1] of the path, velocity and acceleration are derivatives with respect to s
+    CartesianSample pathSample(double s) const;
+
+    // Sample at time t from the start of the move, clamped to the duration
+    CartesianSample sample(double t) const;
+
+    // Sample i of the Ts grid, read from the data matrices when they are filled
+    CartesianSample sampleAt(int i) const;
+
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    int get_length() const;
+    double getTs() const;
+    double getDuration() const;
+    Evaluation getEvaluation() const;
+    OrientationPath getOrientationPath() const;
 
-    int get_length();
+    // Orientation of RPY angles, as RobotArm builds its targets: R = Ry(yaw) Rx(pitch) Rz(roll)
+    static Quaterniond rpyToQuaternion(const Vector3d &PHI);
 };
 
 #endif
@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <ros/ros.h>
+#include "sensor_msgs/JointState.h"
+#include <control_msgs/FollowJointTrajectoryAction.h>
+#include <actionlib/server/simple_action_server.h>
+
+typedef actionlib::SimpleActionServer<control_msgs::FollowJointTrajectoryAction> arm_control_server;
+
+//CLASS TO STAND IN FOR THE ARM TRAJECTORY CONTROLLER
+//a new goal replaces the running trajectory from its first point still in the future, as
+//joint_trajectory_controller does, so streamed goals can be checked without the simulator
+class FakeArmController
+{
+private:
+    ros::NodeHandle nh;
+    arm_control_server server;
+    ros::Publisher jointStatePub;
+    ros::Timer timer;
+
+    std::vector<std::string> jointNames; // order of the stored positions
+    std::vector<double> position;        // current joint positions
+
+    // Running trajectory, absolute times
+    std::vector<ros::Time> times;
+    std::vector<std::vector<double>> points;
+    ros::Time stopped; // end of the last trajectory, zero while moving or before the first goal
+
+    // Accepts the new goal and splices it after the current position
+    void goalCallback()
+    {
+        control_msgs::FollowJointTrajectoryGoalConstPtr goal = server.acceptNewGoal();
+        const trajectory_msgs::JointTrajectory &trajectory = goal->trajectory;
+        ros::Time now = ros::Time::now();
+        ros::Time stamp = trajectory.header.stamp.isZero() ? now : trajectory.header.stamp;
+
+        if (!times.empty())
+            ROS_INFO("Goal received %.3f s before the end of the running trajectory, motion continues", (times.back() - now).toSec());
+        else if (!stopped.isZero())
+            ROS_INFO("Goal received %.3f s after the arm stopped", (now - stopped).toSec());
+
+        // Column of every goal joint in the stored order
+        std::vector<int> index(trajectory.joint_names.size(), -1);
+        for (unsigned int j = 0; j < trajectory.joint_names.size(); j++)
+        {
+            std::vector<std::string>::iterator it = std::find(jointNames.begin(), jointNames.end(), trajectory.joint_names[j]);
+            if (it == jointNames.end())
+            {
+                ROS_ERROR("Unknown joint %s", trajectory.joint_names[j].c_str());
+                server.setAborted();
+                return;
+            }
+            index[j] = it - jointNames.begin();
+        }
+
+        // Points already in the past are dropped, the arm moves from where it is to the first future one
+        times.assign(1, now);
+        points.assign(1, position);
+        int dropped = 0;
+        for (unsigned int i = 0; i < trajectory.points.size(); i++)
+        {
+            ros::Time t = stamp + trajectory.points[i].time_from_start;
+            if (t <= now)
+            {
+                dropped++;
+                continue;
+            }
+
+            std::vector<double> point = position;
+            for (unsigned int j = 0; j < index.size(); j++)
+                point[index[j]] = trajectory.points[i].positions[j];
+            times.push_back(t);
+            points.push_back(point);
+        }
+        if (dropped > 0)
+            ROS_INFO("%d points of the goal were already in the past", dropped);
+
+        stopped = ros::Time();
+    }
+
+    void preemptCallback()
+    {
+        // A replacing goal is handled by goalCallback, a cancel stops the arm where it is
+        if (server.isNewGoalAvailable())
+            return;
+
+        times.clear();
+        points.clear();
+        stopped = ros::Time::now();
+        server.setPreempted();
+    }
+
+    // Linear interpolation of the running trajectory and joint state publication
+    void update(const ros::TimerEvent &)
+    {
+        ros::Time now = ros::Time::now();
+        if (!times.empty())
+        {
+            unsigned int k = std::upper_bound(times.begin(), times.end(), now) - times.begin();
+            if (k >= times.size())
+            {
+                position = points.back();
+                times.clear();
+                points.clear();
+                stopped = now;
+                if (server.isActive())
+                    server.setSucceeded();
+            }
+            else
+            {
+                double alpha = (now - times[k - 1]).toSec() / (times[k] - times[k - 1]).toSec();
+                for (unsigned int j = 0; j < position.size(); j++)
+                    position[j] = points[k - 1][j] + alpha * (points[k][j] - points[k - 1][j]);
+            }
+        }
+
+        // Joints in alphabetical order, as the real joint_states
+        sensor_msgs::JointState msg;
+        msg.header.stamp = now;
+        std::vector<std::string> sorted = jointNames;
+        std::sort(sorted.begin(), sorted.end());
+        for (unsigned int j = 0; j < sorted.size(); j++)
+        {
+            msg.name.push_back(sorted[j]);
+            msg.position.push_back(position[std::find(jointNames.begin(), jointNames.end(), sorted[j]) - jointNames.begin()]);
+        }
+        jointStatePub.publish(msg);
+    }
+
+public:
+    // Constructor
+    FakeArmController(ros::NodeHandle &private_nh)
+        : server(nh, "/robot/arm/pos_traj_controller/follow_joint_trajectory", false)
+    {
+        jointNames = {
+            "robot_arm_shoulder_pan_joint",
+            "robot_arm_shoulder_lift_joint",
+            "robot_arm_elbow_joint",
+            "robot_arm_wrist_1_joint",
+            "robot_arm_wrist_2_joint",
+            "robot_arm_wrist_3_joint"};
+        private_nh.param("initial_positions", position, std::vector<double>(jointNames.size(), 0.0));
+        position.resize(jointNames.size(), 0.0);
+
+        double rate;
+        private_nh.param("rate", rate, 125.0);
+
+        jointStatePub = nh.advertise<sensor_msgs::JointState>("/robot/joint_states", 1);
+        server.registerGoalCallback(boost::bind(&FakeArmController::goalCallback, this));
+        server.registerPreemptCallback(boost::bind(&FakeArmController::preemptCallback, this));
+        server.start();
+        timer = nh.createTimer(ros::Duration(1.0 / rate), &FakeArmController::update, this);
+    }
+};
+
+/**
+ * MAIN
+ */
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "fake_arm_controller");
+    ros::NodeHandle private_nh("~");
+
+    FakeArmController controller(private_nh);
+    ROS_INFO("Fake arm controller ready");
+
+    ros::spin();
+    return 0;
+}
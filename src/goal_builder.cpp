@@ -0,0 +1,82 @@
+#include "goal_builder.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+// Constructor
+GoalBuilder::GoalBuilder(const std::vector<std::string> &jointNames)
+{
+    goal.trajectory.joint_names = jointNames;
+}
+
+void GoalBuilder::clear()
+{
+    std::vector<Point> &points = goal.trajectory.points;
+    spare.insert(spare.end(), std::make_move_iterator(points.begin()), std::make_move_iterator(points.end()));
+    points.clear();
+    goal.trajectory.header.stamp = ros::Time();
+}
+
+//point at the end of the goal, taken from the spare ones when there are any
+GoalBuilder::Point &GoalBuilder::nextPoint(double time, bool derivatives)
+{
+    std::vector<Point> &points = goal.trajectory.points;
+    if (spare.empty())
+        points.emplace_back();
+    else
+    {
+        points.push_back(std::move(spare.back()));
+        spare.pop_back();
+    }
+
+    Point &point = points.back();
+    point.positions.resize(6);
+    point.velocities.resize(derivatives ? 6 : 0);
+    point.accelerations.resize(derivatives ? 6 : 0);
+    point.effort.clear();
+    point.time_from_start = ros::Duration(time);
+    return point;
+}
+
+int GoalBuilder::append(const TrajectoryMatrix &positions, int begin, int end, double Ts, double offset,
+                        const TrajectoryMatrix *velocities, const TrajectoryMatrix *accelerations, double jointRange)
+{
+    bool derivatives = velocities != NULL && accelerations != NULL;
+    goal.trajectory.points.reserve(goal.trajectory.points.size() + end - begin);
+
+    int dropped = 0;
+    for (int i = begin; i < end; i++)
+    {
+        if (jointRange > 0 && positions.col(i).cwiseAbs().maxCoeff() > jointRange)
+        {
+            dropped++;
+            continue;
+        }
+
+        Point &point = nextPoint(offset + i * Ts, derivatives);
+        std::copy(positions.col(i).data(), positions.col(i).data() + 6, point.positions.begin());
+        if (derivatives)
+        {
+            std::copy(velocities->col(i).data(), velocities->col(i).data() + 6, point.velocities.begin());
+            std::copy(accelerations->col(i).data(), accelerations->col(i).data() + 6, point.accelerations.begin());
+        }
+    }
+    return dropped;
+}
+
+void GoalBuilder::append(const Vector6d &positions, double time)
+{
+    Point &point = nextPoint(time, false);
+    std::copy(positions.data(), positions.data() + 6, point.positions.begin());
+}
+
+void GoalBuilder::setStamp(const ros::Time &stamp)
+{
+    goal.trajectory.header.stamp = stamp;
+}
+
+// GETTERS
+
+const GoalBuilder::Goal &GoalBuilder::getGoal() const { return goal; }
+size_t GoalBuilder::size() const { return goal.trajectory.points.size(); }
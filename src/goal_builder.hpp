@@ -0,0 +1,53 @@
+#ifndef GOAL_BUILDER
+#define GOAL_BUILDER
+
+#include <ros/ros.h>
+#include <control_msgs/FollowJointTrajectoryAction.h>
+#include "trajectory_msgs/JointTrajectoryPoint.h"
+#include <Eigen/Eigen>
+
+#include <string>
+#include <vector>
+
+#include "trajectory_types.hpp"
+
+//CLASS TO BUILD TRAJECTORY GOALS OF THE ARM IN STORAGE KEPT ACROSS MOVES
+//the joint names are set once; points of a cleared goal keep their position, velocity and acceleration
+//buffers aside and the next goals take them back, so once the longest goal has been built a goal costs one
+//pass over the joint matrices and no allocation
+class GoalBuilder
+{
+public:
+    typedef control_msgs::FollowJointTrajectoryGoal Goal;
+    typedef trajectory_msgs::JointTrajectoryPoint Point;
+
+private:
+    Goal goal;
+    std::vector<Point> spare; // points of the previous goals, with their buffers
+
+    Point &nextPoint(double time, bool derivatives);
+
+public:
+    // Constructor
+    explicit GoalBuilder(const std::vector<std::string> &jointNames);
+
+    // Empty goal with the same joint names, the storage is kept
+    void clear();
+
+    // Appends the samples [begin, end) of the joint trajectory (6, length) at offset + i * Ts, velocities and
+    // accelerations are filled in when both are given. Samples with a joint outside +-jointRange are left out
+    // when jointRange is positive; returns how many
+    int append(const TrajectoryMatrix &positions, int begin, int end, double Ts, double offset = 0,
+               const TrajectoryMatrix *velocities = NULL, const TrajectoryMatrix *accelerations = NULL, double jointRange = 0);
+
+    // Appends a single point
+    void append(const Vector6d &positions, double time);
+
+    void setStamp(const ros::Time &stamp);
+
+    // Getters
+    const Goal &getGoal() const;
+    size_t size() const;
+};
+
+#endif
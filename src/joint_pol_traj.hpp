@@ -3,7 +3,9 @@
 
 #include <Eigen/Eigen>
 
+#include "trajectory_types.hpp"
 #include "kdl_kinematics.hpp"
+#include "path_timing_law.hpp"
 
 using namespace Eigen;
 //CLASS TO BUILD JOINT TRAJECTORY
@@ -13,26 +15,33 @@ private:
     int nJoints;                // Number of joints
     int samples;                // Trajectory samples
     double Ts;                  // Sampling time
-    MatrixXd jointPos;          // Joints position matrix (6, samples)
-    MatrixXd jointVel;          // Joints velocity matrix (6, samples)
-    MatrixXd jointAcc;          // Joints acceleration matrix (6, samples)
+    TrajectoryMatrix jointPos;  // Joints position matrix (6, samples)
+    TrajectoryMatrix jointVel;  // Joints velocity matrix (6, samples)
+    TrajectoryMatrix jointAcc;  // Joints acceleration matrix (6, samples)
     std::vector<double> tSeq;   // Time sequence vector
 
     // Type of joint trajectory
     void fifthPolTraj(double* qi, double* qf, double* dqi, double* dqf, double* d2qi, double* d2qf);
+    void optimalTraj(double* qi, double* qf, const PathTimingLaw &law);
+    void boundaryConfigurations(const Vector3d &pi, const Vector3d &pf, const Vector3d &PHI_i, const Vector3d &PHI_f, RobotArm &ra, double joints[],
+                                double* qi, double* qf, double* dqi, double* dqf, double* d2qi, double* d2qf);
+    void initTimeSequence(double ti, double tf);
 
 public:
     // Constructor
-    JointPolTraj(MatrixXd pi, MatrixXd pf, MatrixXd PHI_i, MatrixXd PHI_f, RobotArm ra, double joints[], int nJoints, double ti, double tf, double Ts);
+    JointPolTraj(const Vector3d &pi, const Vector3d &pf, const Vector3d &PHI_i, const Vector3d &PHI_f, RobotArm &ra, double joints[], int nJoints, double ti, double tf, double Ts);
+
+    // Constructor, straight line in joint space in the minimum time allowed by the limits
+    JointPolTraj(const Vector3d &pi, const Vector3d &pf, const Vector3d &PHI_i, const Vector3d &PHI_f, RobotArm &ra, double joints[], int nJoints, const JointLimits &limits, double Ts);
 
     // Getters
-    int getNJoints();
-    int getSamples();
-    double getTs();
-    MatrixXd getJointPos();
-    MatrixXd getJointVel();
-    MatrixXd getJointAcc();
-    std::vector<double> getTSeq();
+    int getNJoints() const;
+    int getSamples() const;
+    double getTs() const;
+    const TrajectoryMatrix &getJointPos() const;
+    const TrajectoryMatrix &getJointVel() const;
+    const TrajectoryMatrix &getJointAcc() const;
+    const std::vector<double> &getTSeq() const;
 };
 
 #endif
@@ -14,94 +14,258 @@
 #include <tf/transform_broadcaster.h>
 #include <kdl/jntarray.hpp>
 #include "kdl_kinematics.hpp"
+#include "metrics.hpp"
 #include <tf/transform_listener.h>
 #include <Eigen/Eigen>
 #include <Eigen/Dense>
 #include <Eigen/Geometry>
 #include <Eigen/Eigenvalues>
+#define _USE_MATH_DEFINES // For PI costants
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <limits>
 
-RobotArm::RobotArm(ros::NodeHandle nh_)
+// Same tolerance as the default one of ChainIkSolverPos_LMA
+static const double IK_EPS = 1e-5;
+
+// LMA iterations between two checks of the time budget
+static const int IK_SLICE_ITERATIONS = 25;
+
+// [rad] largest change of a joint from the given seed to a seed map one, farther seeds may lead to another branch
+static const double SEED_MAP_RANGE = M_PI / 2;
+
+// Damping of the least squares solution of the joint velocities and accelerations, bounds them near singularities
+static const double VEL_DAMPING = 1e-3;
+
+RobotArm::RobotArm(ros::NodeHandle &nh_) : RobotArm(readRobotDescription(nh_))
 {
-    std::string robot_desc_string;
-    nh_.param("robot/robot_description", robot_desc_string, std::string());
+}
+
+RobotArm::RobotArm(const std::string &robot_desc_string)
+    : chain(std::make_shared<KDL::Chain>()), solvers(std::make_shared<SolverPool>()), backend(IK_LMA)
+{
+    KDL::Tree my_tree;
     if (!kdl_parser::treeFromString(robot_desc_string, my_tree))
     {
         ROS_ERROR("Failed to construct kdl tree");
     }
-    KDL::SegmentMap::const_iterator root_seg;
-    root_seg = my_tree.getRootSegment();
-    my_tree.getChain("robot_base_footprint", "robot_arm_tool0", chain);
+    my_tree.getChain("robot_base_footprint", "robot_arm_tool0", *chain);
+    analytic = fitAnalyticModel(*chain);
 }
 
-KDL::Frame RobotArm::FKinematics(double joints[6])
+std::string RobotArm::readRobotDescription(ros::NodeHandle &nh_)
+{
+    std::string robot_desc_string;
+    nh_.param("robot/robot_description", robot_desc_string, std::string());
+    return robot_desc_string;
+}
+
+RobotArm::SolverSet::SolverSet(std::shared_ptr<const KDL::Chain> chain)
+    : chain(chain),
+      fk(*chain),
+      ik_p(*chain),
+      ik_slice(*chain, IK_EPS, IK_SLICE_ITERATIONS),
+      q_try(chain->getNrOfJoints()),
+      q_best(chain->getNrOfJoints()),
+      q_seed(chain->getNrOfJoints()),
+      q_out(chain->getNrOfJoints())
+{
+}
+
+//solvers of the calling thread, built on its first call. Every thread keeps its sets with a weak reference to
+//the pool of their arm: the reference keeps the control block alive, so it cannot match a later pool, and the
+//sets of arms gone meanwhile are dropped when the thread builds a new one
+RobotArm::SolverSet &RobotArm::getSolvers()
+{
+    typedef std::pair<std::weak_ptr<SolverPool>, std::unique_ptr<SolverSet>> Entry;
+    static thread_local std::vector<Entry> sets;
+
+    for (unsigned int i = 0; i < sets.size(); i++)
+        if (!sets[i].first.owner_before(solvers) && !solvers.owner_before(sets[i].first))
+            return *sets[i].second;
+
+    sets.erase(std::remove_if(sets.begin(), sets.end(), [](const Entry &entry) { return entry.first.expired(); }), sets.end());
+    sets.emplace_back(solvers, std::unique_ptr<SolverSet>(new SolverSet(chain)));
+    return *sets.back().second;
+}
+
+//workers shared by all the copies of the arm, built once with the size of the first request: other copies may be
+//running batches on them, so they are never rebuilt and later requests of another size share them
+ThreadPool &RobotArm::getThreadPool(int nThreads)
+{
+    std::call_once(solvers->threadsOnce, [this, nThreads]() { solvers->threads.reset(new ThreadPool(nThreads)); });
+    return *solvers->threads;
+}
+
+const KDL::Chain &RobotArm::getChain() const
+{
+    return *chain;
+}
+
+static Eigen::Isometry3d toEigen(const KDL::Frame &frame)
+{
+    Eigen::Isometry3d pose = Eigen::Isometry3d::Identity();
+    for (int i = 0; i < 3; i++)
+    {
+        for (int j = 0; j < 3; j++)
+            pose.linear()(i, j) = frame.M(i, j);
+        pose.translation()(i) = frame.p(i);
+    }
+    return pose;
+}
+
+//looks for the base and tool frames making the UR5 closed form match the chain
+std::shared_ptr<UR5Kinematics> RobotArm::fitAnalyticModel(const KDL::Chain &chain)
 {
-    KDL::ChainFkSolverPos_recursive fk = KDL::ChainFkSolverPos_recursive(chain);
     unsigned int nj = chain.getNrOfJoints();
-    KDL::JntArray jointpositions = KDL::JntArray(nj);
-    for (unsigned int i = 0; i < nj; i++)
+    if (nj != 6)
+        return std::shared_ptr<UR5Kinematics>();
+
+    // Fixed segments before the first joint bring to the base link of the arm
+    KDL::Frame armBase = KDL::Frame::Identity();
+    for (unsigned int i = 0; i < chain.getNrOfSegments(); i++)
     {
-        if (i == 0)
-        {
-            jointpositions(i) = joints[2];
-        }
-        else if (i == 1)
-        {
-            jointpositions(i) = joints[1];
-        }
-        else if (i == 2)
-        {
-            jointpositions(i) = joints[0];
-        }
-        else
+        const KDL::Segment &segment = chain.getSegment(i);
+        if (segment.getJoint().getType() != KDL::Joint::None)
+            break;
+        armBase = armBase * segment.pose(0);
+    }
+
+    KDL::ChainFkSolverPos_recursive fk(chain);
+    KDL::JntArray q(nj);
+    KDL::Frame chainPose;
+    double zero[6] = {0, 0, 0, 0, 0, 0};
+    SetToZero(q);
+    fk.JntToCart(q, chainPose);
+
+    // The DH base frame is rotated around z with respect to the base link, by pi in the ROS-Industrial description
+    const double baseYaw[4] = {M_PI, 0, M_PI_2, -M_PI_2};
+    std::shared_ptr<UR5Kinematics> model = std::make_shared<UR5Kinematics>();
+    for (int b = 0; b < 4; b++)
+    {
+        Eigen::Isometry3d base = toEigen(armBase) * Eigen::AngleAxisd(baseYaw[b], Eigen::Vector3d::UnitZ());
+        Eigen::Isometry3d tool = (base * model->forwardDH(zero)).inverse() * toEigen(chainPose);
+        model->setMounting(base, tool);
+
+        // Both models have to agree on a spread of configurations
+        bool match = true;
+        for (int k = 0; k < 8 && match; k++)
         {
-            jointpositions(i) = joints[i];
+            double qk[6];
+            for (unsigned int j = 0; j < nj; j++)
+            {
+                qk[j] = 2.5 * sin(1.3 * k + 0.7 * j);
+                q(j) = qk[j];
+            }
+            fk.JntToCart(q, chainPose);
+            Eigen::Isometry3d error = model->forward(qk).inverse() * toEigen(chainPose);
+            match = error.translation().norm() < 1e-6 && (error.linear() - Eigen::Matrix3d::Identity()).norm() < 1e-6;
         }
+        if (match)
+            return model;
+
+        SetToZero(q);
+        fk.JntToCart(q, chainPose);
     }
 
-    KDL::Frame cartpos;
-    bool kinematics_status;
-    kinematics_status = fk.JntToCart(jointpositions, cartpos); // @todo check what to do with this status
-    return cartpos;
+    return std::shared_ptr<UR5Kinematics>();
 }
 
-KDL::JntArray RobotArm::IKinematics(double X, double Y, double Z, double roll, double pitch, double yaw, double joints[6], Eigen::MatrixXd &operational_velocities, int pos, Eigen::MatrixXd &operational_acc, int length, double vel_[6], double acc_[6])
+bool RobotArm::setIKBackend(IKBackend backend)
 {
-    KDL::ChainFkSolverPos_recursive fk = KDL::ChainFkSolverPos_recursive(chain);
+    if (backend == IK_ANALYTIC && !analytic)
+    {
+        ROS_WARN("The chain does not match the UR5 geometry, inverse kinematics stays on LMA");
+        this->backend = IK_LMA;
+        return false;
+    }
+    this->backend = backend;
+    return true;
+}
 
-    unsigned int nj = chain.getNrOfJoints();
-    KDL::JntArray jointpositions = KDL::JntArray(nj);
-    std::vector<std::string> endpoints;
-    endpoints.push_back("robot_arm_tool0");
-
-    /*
-      for the current joints positions you can read it from joint_states, remember that you have to swap the first and the third value
-      joint_states publish in alphabetical order, but for the kinematics you need the actual order
-    */
+RobotArm::IKBackend RobotArm::getIKBackend() const
+{
+    return backend;
+}
+
+const UR5Kinematics *RobotArm::getAnalyticModel() const
+{
+    return analytic.get();
+}
+
+void RobotArm::setIKBudget(const IKBudget &budget)
+{
+    this->budget = budget;
+}
+
+const RobotArm::IKBudget &RobotArm::getIKBudget() const
+{
+    return budget;
+}
+
+bool RobotArm::setSeedMap(std::shared_ptr<const SeedMap> seedMap)
+{
+    if (seedMap && (!analytic || seedMap->getGrid().tag != SeedMap::modelTag(*analytic)))
+    {
+        ROS_WARN("The seed map was built for another robot model, it is not used");
+        this->seedMap.reset();
+        return false;
+    }
+    this->seedMap = seedMap;
+    return true;
+}
+
+/*
+  for the current joints positions you can read it from joint_states, remember that you have to swap the first and the third value
+  joint_states publish in alphabetical order, but for the kinematics you need the actual order
+*/
+void RobotArm::loadSeed(KDL::JntArray &q, double joints[6])
+{
+    unsigned int nj = chain->getNrOfJoints();
     for (unsigned int i = 0; i < nj; i++)
     {
         if (i == 0)
         {
-            jointpositions(i) = joints[2];
+            q(i) = joints[2];
         }
         else if (i == 1)
         {
-            jointpositions(i) = joints[1];
+            q(i) = joints[1];
         }
         else if (i == 2)
         {
-            jointpositions(i) = joints[0];
+            q(i) = joints[0];
         }
         else
         {
-            jointpositions(i) = joints[i];
+            q(i) = joints[i];
         }
     }
+}
+
+void RobotArm::toSeed(const Vector6d &q, double joints[6])
+{
+    joints[0] = q(2);
+    joints[1] = q(1);
+    joints[2] = q(0);
+    for (int i = 3; i < 6; i++)
+        joints[i] = q(i);
+}
+
+KDL::Frame RobotArm::FKinematics(double joints[6])
+{
+    SolverSet &s = getSolvers();
+    loadSeed(s.q_seed, joints);
 
-    KDL::ChainIkSolverVel_wdls ik_v = KDL::ChainIkSolverVel_wdls(chain);
-    KDL::ChainIkSolverPos_LMA ik_p = KDL::ChainIkSolverPos_LMA(chain);
-    // KDL::ChainIkSolverAcc	ik_a = KDL::ChainIkSolverAcc(chain);
+    KDL::Frame cartpos;
+    bool kinematics_status;
+    kinematics_status = s.fk.JntToCart(s.q_seed, cartpos); // @todo check what to do with this status
+    return cartpos;
+}
 
-    // You have done with the initialization part, now you can use IK
+KDL::Frame RobotArm::targetFrame(double X, double Y, double Z, double roll, double pitch, double yaw)
+{
     // Use directly a quaternion or create one from RPY values
     tf::Quaternion q1;
     q1.setEuler(yaw, pitch, roll);
@@ -115,57 +279,459 @@ KDL::JntArray RobotArm::IKinematics(double X, double Y, double Z, double roll, d
     //translation
     KDL::Vector V1 = KDL::Vector(X, Y, Z);
 
-    KDL::Frame target = KDL::Frame(R1, V1);
+    return KDL::Frame(R1, V1);
+}
 
-    KDL::JntArray target_joints = KDL::JntArray(nj);
-    KDL::JntArray target_joints_vel = KDL::JntArray(nj);
-    KDL::JntArray target_joints_acc = KDL::JntArray(nj);
+//seed of the map cell of the target in place of the given one, when it starts closer to the target and every joint,
+//unwrapped next to the given seed, is within SEED_MAP_RANGE of it; false when the seed is kept
+bool RobotArm::mapSeed(SolverSet &s, const KDL::Frame &target, KDL::JntArray &seed)
+{
+    double q[6];
+    Eigen::Isometry3d pose = toEigen(target);
+    if (!seedMap || backend != IK_LMA || !seedMap->lookup(pose.translation(), pose.linear(), q))
+        return false;
 
-    double result_p = ik_p.CartToJnt(jointpositions, target, target_joints); //@todo check the meaning of result -3 KDL::SolverI::E_NOERROR
+    for (int j = 0; j < 6; j++)
+    {
+        s.q_try(j) = seed(j) + std::remainder(q[j] - seed(j), 2 * M_PI);
+        if (std::abs(s.q_try(j) - seed(j)) > SEED_MAP_RANGE)
+            return false;
+    }
+    if (poseResidual(s, s.q_try, target) >= poseResidual(s, seed, target))
+        return false;
+    seed.data = s.q_try.data;
+    Metrics::count(Metrics::IK_SEED_MAP_HITS);
+    return true;
+}
 
-    //std::cout << "\nresult ik_p "<<result_p<<std::endl;
+//position IK from the seed, LMA is skipped when the seed already reaches the target
+int RobotArm::solvePosition(SolverSet &s, const KDL::Frame &target, const KDL::JntArray &seed, KDL::JntArray &q_out)
+{
+    Metrics::ScopedTimer timer(Metrics::IK_SAMPLE_TIME);
+    Metrics::count(Metrics::IK_SOLVES);
 
-    // tf::TransformListener listener;
-    // tf::StampedTransform transform;
+    // Closed form branch closest to the seed, LMA is still used for unreachable targets
+    if (backend == IK_ANALYTIC && analytic->closestSolution(toEigen(target), seed.data.data(), q_out.data.data()))
+        return KDL::SolverI::E_NOERROR;
 
-    // std::string *error_msg=NULL; // @todo check the transform for the velocity
+    s.fk.JntToCart(seed, s.frame);
+    KDL::Twist error = KDL::diff(s.frame, target);
+    if (error.vel.Norm() < IK_EPS && error.rot.Norm() < IK_EPS)
+    {
+        q_out.data = seed.data;
+        Metrics::count(Metrics::IK_SEED_HITS);
+        return KDL::SolverI::E_NOERROR;
+    }
 
-    // listener.waitForTransform("robot_wsg50_center","robot_base_footprint", ros::Time(0),  ros::Duration(0.5), ros::Duration(0.01), error_msg=NULL);
-    // listener.lookupTransform("robot_wsg50_center","robot_base_footprint",ros::Time(0), transform);
-    //listener.waitForTransform("/robot_base_link", "/robot_arm_tool0",ros::Time::now(), transform);
-    // std::cout << " transform : " << transform.getOrigin().x() << " "<< transform.getOrigin().y()<< " " << transform.getOrigin().z()<< std::endl;
-    // KDL::Vector v_base(0,0,0); // base del robot
-    // KDL::Vector v_gripper(transform.getOrigin().x(),transform.getOrigin().y(),transform.getOrigin().z()); // end effector
+    int result = s.ik_p.CartToJnt(seed, target, q_out);
+    if (Metrics::isEnabled())
+    {
+        Metrics::record(Metrics::IK_ITERATIONS, s.ik_p.lastNrOfIter);
+        Metrics::record(Metrics::IK_RESIDUAL, s.ik_p.lastDifference);
+        if (result < 0)
+            Metrics::count(Metrics::IK_ERRORS);
+    }
+    return result;
+}
 
-    KDL::Twist tw = KDL::Twist::Zero();
-    tw.vel.x(operational_velocities.coeff(0, pos));
-    tw.vel.y(operational_velocities.coeff(1, pos));
-    tw.vel.z(operational_velocities.coeff(2, pos));
-    tw.rot.x(operational_velocities.coeff(3, pos));
-    tw.rot.y(operational_velocities.coeff(4, pos));
-    tw.rot.z(operational_velocities.coeff(5, pos));
+//largest of the position and rotation errors of the FK of q from the target
+double RobotArm::poseResidual(SolverSet &s, const KDL::JntArray &q, const KDL::Frame &target)
+{
+    s.fk.JntToCart(q, s.frame);
+    KDL::Twist error = KDL::diff(s.frame, target);
+    return std::max(error.vel.Norm(), error.rot.Norm());
+}
 
-    double result_v = ik_v.CartToJnt(target_joints, tw, target_joints_vel);
+//position IK within the budget, returns the residual of the best solution found; LMA runs in slices of
+//iterations so that the time is checked between them, and starts again from another seed while it does not converge
+double RobotArm::solveChecked(SolverSet &s, const KDL::Frame &target, const KDL::JntArray &seed, KDL::JntArray &q_out, IKReport &report)
+{
+    typedef std::chrono::steady_clock Clock;
+    Metrics::ScopedTimer timer(Metrics::IK_SAMPLE_TIME);
+    Metrics::count(Metrics::IK_SOLVES);
 
-    //std::cout<<"result ik_v " << result_v << std::endl;
+    Clock::time_point start = Clock::now();
+    auto overTime = [&]() {
+        return budget.maxTime > 0 && std::chrono::duration<double>(Clock::now() - start).count() > budget.maxTime;
+    };
+    unsigned int nj = chain->getNrOfJoints();
+    double bestResidual = std::numeric_limits<double>::infinity();
+    int sampleIterations = 0;
+    bool retried = false;
 
-    for (int idx = 0; idx < 6; idx++)
-        vel_[idx] = target_joints_vel.data[idx];
+    for (int attempt = 0; attempt <= budget.retries; attempt++)
+    {
+        // Seeds: the given one (or the closed form branch next to it), the same with wrapped joints,
+        // the closed form branch next to it for the LMA backend, then deterministic perturbations
+        s.q_try.data = seed.data;
+        if (attempt == 0)
+        {
+            if (backend == IK_ANALYTIC)
+                analytic->closestSolution(toEigen(target), seed.data.data(), s.q_try.data.data());
+        }
+        else if (attempt == 1)
+        {
+            for (unsigned int j = 0; j < nj; j++)
+                s.q_try(j) = std::remainder(seed(j), 2 * M_PI);
+            if (s.q_try.data == seed.data)
+                continue;
+        }
+        else if (!(attempt == 2 && backend == IK_LMA && analytic && analytic->closestSolution(toEigen(target), seed.data.data(), s.q_try.data.data())))
+        {
+            for (unsigned int j = 0; j < nj; j++)
+                s.q_try(j) += 0.5 * sin(1.7 * attempt + j);
+        }
+
+        // A sample solved again counts once, whatever the number of seeds it takes
+        retried = retried || attempt > 0;
+        int iterations = 0;
+        double residual = poseResidual(s, s.q_try, target);
+        while (residual > budget.tolerance && iterations < budget.maxIterations && !overTime())
+        {
+            int result = s.ik_slice.CartToJnt(s.q_try, target, s.q_out);
+            iterations += std::max(1, s.ik_slice.lastNrOfIter);
+            s.q_try.data = s.q_out.data;
+            residual = poseResidual(s, s.q_try, target);
+
+            // LMA stopped before the end of the slice, converged on its own criteria or stuck
+            if (result == KDL::SolverI::E_NOERROR || s.ik_slice.lastNrOfIter < IK_SLICE_ITERATIONS)
+                break;
+        }
+        sampleIterations += iterations;
+
+        if (residual < bestResidual)
+        {
+            bestResidual = residual;
+            s.q_best.data = s.q_try.data;
+        }
+        if (bestResidual <= budget.tolerance || overTime())
+            break;
+    }
+    q_out.data = s.q_best.data;
+
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    report.iterations += sampleIterations;
+    report.retried += retried;
+    report.maxIterations = std::max(report.maxIterations, sampleIterations);
+    report.maxResidual = std::max(report.maxResidual, bestResidual);
+    report.maxTime = std::max(report.maxTime, elapsed);
+    Metrics::record(Metrics::IK_ITERATIONS, sampleIterations);
+    Metrics::record(Metrics::IK_RESIDUAL, bestResidual);
+    return bestResidual;
+}
+
+KDL::JntArray RobotArm::IKinematics(double X, double Y, double Z, double roll, double pitch, double yaw, double joints[6], const TrajectoryMatrix &operational_velocities, int pos, const TrajectoryMatrix &operational_acc, int length, double vel_[6], double acc_[6])
+{
+    KDL::JntArray target_joints = IKinematics(targetFrame(X, Y, Z, roll, pitch, yaw), joints);
 
-    // KDL::Twist tw = KDL::Twist::Zero();
-    //   tw.vel.x(operational_acc.coeff(0,i));
-    //   tw.vel.y(operational_acc.coeff(1,i));
-    //   tw.vel.z(operational_acc.coeff(2,i));
-    //   tw.rot.x(operational_acc.coeff(3,i));
-    //   tw.rot.y(operational_acc.coeff(4,i));
-    //   tw.rot.z(operational_acc.coeff(5,i));
+    //velocities and accelerations are (position, RPY angles) rates, as the trajectory samples
+    Vector6d pose, twist, twistDot, qd, qdd;
+    pose << X, Y, Z, roll, pitch, yaw;
+    operationalTwist(pose, operational_velocities.col(pos), operational_acc.col(pos), twist, twistDot);
+    solveDerivatives(target_joints, twist, twistDot, qd, qdd);
 
-    // double result_a = ik_a.CartToJnt(target_joints,target_joints_vel,tw,target_joints_acc);
+    for (int idx = 0; idx < 6; idx++)
+    {
+        vel_[idx] = qd(idx);
+        acc_[idx] = qdd(idx);
+    }
 
-    // std::cout<<"result ik_a " << result_a << std::endl;
+    return target_joints;
+}
+
+KDL::JntArray RobotArm::IKinematics(const KDL::Frame &target, double joints[6])
+{
+    SolverSet &s = getSolvers();
+    loadSeed(s.q_seed, joints);
+    bool mapped = mapSeed(s, target, s.q_seed);
 
-    for(int idx =0;idx<6;idx++)
-      acc_[idx] = target_joints_acc.data[idx];
+    KDL::JntArray target_joints = KDL::JntArray(chain->getNrOfJoints());
+    int result = solvePosition(s, target, s.q_seed, target_joints); //@todo check the meaning of result -3 KDL::SolverI::E_NOERROR
 
+    // LMA failing from the map seed starts again from the given one, the better solution is kept
+    if (result < 0 && mapped)
+    {
+        KDL::JntArray retry = KDL::JntArray(chain->getNrOfJoints());
+        loadSeed(s.q_seed, joints);
+        solvePosition(s, target, s.q_seed, retry);
+        if (poseResidual(s, retry, target) < poseResidual(s, target_joints, target))
+            target_joints = retry;
+    }
     return target_joints;
-}
\ No newline at end of file
+}
+
+//twist of the end effector and its derivative from the rates of (position, RPY angles), with the rotation
+//of targetFrame: R = Ry(yaw) Rx(pitch) Rz(roll)
+void RobotArm::operationalTwist(const Vector6d &pose, const Vector6d &velocity, const Vector6d &acceleration, Vector6d &twist, Vector6d &twistDot)
+{
+    double pitch = pose(4), yaw = pose(5);
+    Eigen::Vector3d rollAxis(sin(yaw) * cos(pitch), -sin(pitch), cos(yaw) * cos(pitch));
+    Eigen::Vector3d pitchAxis(cos(yaw), 0, -sin(yaw));
+    Eigen::Vector3d yawAxis = Eigen::Vector3d::UnitY();
+
+    Eigen::Vector3d yawRate = velocity(5) * yawAxis, pitchRate = velocity(4) * pitchAxis, rollRate = velocity(3) * rollAxis;
+    twist << velocity.head<3>(), rollRate + pitchRate + yawRate;
+
+    //the pitch axis turns with the yaw, the roll axis with both
+    twistDot << acceleration.head<3>(),
+        acceleration(3) * rollAxis + acceleration(4) * pitchAxis + acceleration(5) * yawAxis +
+            yawRate.cross(pitchRate) + (yawRate + pitchRate).cross(rollRate);
+}
+
+//joint velocities and accelerations giving the twist and its derivative at q, revolute joints only:
+//qd = J+ twist, qdd = J+ (twistDot - dJ/dt qd), with the Jacobian built and factorized once
+void RobotArm::solveDerivatives(const KDL::JntArray &q, const Vector6d &twist, const Vector6d &twistDot, Vector6d &qd, Vector6d &qdd) const
+{
+    // Joint axes and origins in the base frame, one pass on the chain
+    Eigen::Vector3d axes[6], origins[6];
+    KDL::Frame T = KDL::Frame::Identity();
+    int j = 0;
+    for (unsigned int k = 0; k < chain->getNrOfSegments(); k++)
+    {
+        const KDL::Segment &segment = chain->getSegment(k);
+        if (segment.getJoint().getType() == KDL::Joint::None || j == 6)
+        {
+            T = T * segment.pose(0);
+            continue;
+        }
+        KDL::Vector axis = T.M * segment.getJoint().JointAxis();
+        KDL::Vector origin = T * segment.getJoint().JointOrigin();
+        axes[j] << axis.x(), axis.y(), axis.z();
+        origins[j] << origin.x(), origin.y(), origin.z();
+        T = T * segment.pose(q(j));
+        j++;
+    }
+    Eigen::Vector3d tool(T.p.x(), T.p.y(), T.p.z());
+
+    Eigen::Matrix<double, 6, 6> J;
+    for (int i = 0; i < 6; i++)
+        J.col(i) << axes[i].cross(tool - origins[i]), axes[i];
+
+    // Damped least squares, J^T (J J^T + l^2 I)^-1, the factorization serves both solves
+    Eigen::Matrix<double, 6, 6> JJt = J * J.transpose();
+    JJt.diagonal().array() += VEL_DAMPING * VEL_DAMPING;
+    Eigen::LDLT<Eigen::Matrix<double, 6, 6>> ldlt(JJt);
+    qd = J.transpose() * ldlt.solve(twist);
+
+    // dJ/dt qd: every axis turns with the joints before it, every origin moves with them.
+    // W and S accumulate sum(qd_j z_j) and sum(qd_j z_j x o_j) over the joints before i
+    Eigen::Vector3d W = Eigen::Vector3d::Zero(), S = Eigen::Vector3d::Zero();
+    Eigen::Vector3d axisRates[6], originRates[6];
+    for (int i = 0; i < 6; i++)
+    {
+        axisRates[i] = W.cross(axes[i]);
+        originRates[i] = W.cross(origins[i]) - S;
+        W += qd(i) * axes[i];
+        S += qd(i) * axes[i].cross(origins[i]);
+    }
+    Eigen::Vector3d toolRate = W.cross(tool) - S;
+
+    Vector6d bias = Vector6d::Zero();
+    for (int i = 0; i < 6; i++)
+    {
+        bias.head<3>() += qd(i) * (axisRates[i].cross(tool - origins[i]) + axes[i].cross(toolRate - originRates[i]));
+        bias.tail<3>() += qd(i) * axisRates[i];
+    }
+    qdd = J.transpose() * ldlt.solve(twistDot - bias);
+}
+
+KDL::Frame RobotArm::sampleFrame(const CartesianSample &sample)
+{
+    // SLERP samples carry their orientation, no RPY conversion
+    if (sample.slerp)
+    {
+        const Eigen::Quaterniond &o = sample.orientation;
+        return KDL::Frame(KDL::Rotation::Quaternion(o.x(), o.y(), o.z(), o.w()), KDL::Vector(sample.position(0), sample.position(1), sample.position(2)));
+    }
+    return targetFrame(
+        sample.position(0), sample.position(1), sample.position(2),
+        sample.position(3), sample.position(4), sample.position(5));
+}
+
+//twist and its derivative of a trajectory sample, SLERP samples already hold the angular ones
+void RobotArm::sampleTwist(const CartesianSample &sample, Vector6d &twist, Vector6d &twistDot)
+{
+    if (sample.slerp)
+    {
+        twist = sample.velocity;
+        twistDot = sample.acceleration;
+    }
+    else
+        operationalTwist(sample.position, sample.velocity, sample.acceleration, twist, twistDot);
+}
+
+//checked IK of sample i from s.q_seed into column i, rejected samples go in the report; the solution is the next seed
+void RobotArm::solveSampleChecked(SolverSet &s, const CartesianSample &sample, int i, TrajectoryMatrix &jointPos, IKReport &report,
+                                  TrajectoryMatrix *jointVel, TrajectoryMatrix *jointAcc)
+{
+    double residual = solveChecked(s, sampleFrame(sample), s.q_seed, s.q_out, report);
+
+    // Same angles modulo 2 pi closest to the previous sample, so the arm never turns a joint around
+    bool inRange = true;
+    for (int j = 0; j < 6; j++)
+    {
+        s.q_out(j) += 2 * M_PI * std::round((s.q_seed(j) - s.q_out(j)) / (2 * M_PI));
+        inRange = inRange && std::abs(s.q_out(j)) <= budget.jointRange;
+    }
+    if (residual > budget.tolerance || !inRange)
+        report.rejected.push_back(i);
+    jointPos.col(i) = s.q_out.data;
+
+    if (jointVel != NULL && jointAcc != NULL)
+    {
+        Vector6d twist, twistDot, qd, qdd;
+        sampleTwist(sample, twist, twistDot);
+        solveDerivatives(s.q_out, twist, twistDot, qd, qdd);
+        jointVel->col(i) = qd;
+        jointAcc->col(i) = qdd;
+    }
+    s.q_seed.data = s.q_out.data;
+}
+
+//position IK of sample i warm started from s.q_seed, which moves on to the solution; velocities and accelerations
+//are solved only when their matrices are given
+void RobotArm::solveSample(SolverSet &s, const CartesianSample &sample, int i, TrajectoryMatrix &jointPos, TrajectoryMatrix *jointVel, TrajectoryMatrix *jointAcc)
+{
+    solvePosition(s, sampleFrame(sample), s.q_seed, s.q_out);
+    jointPos.col(i) = s.q_out.data;
+
+    if (jointVel != NULL && jointAcc != NULL)
+    {
+        Vector6d twist, twistDot, qd, qdd;
+        sampleTwist(sample, twist, twistDot);
+        solveDerivatives(s.q_out, twist, twistDot, qd, qdd);
+        jointVel->col(i) = qd;
+        jointAcc->col(i) = qdd;
+    }
+
+    //the next sample starts from this solution, close to its own and on the same branch
+    s.q_seed.data = s.q_out.data;
+}
+
+TrajectoryMatrix RobotArm::solveTrajectory(const CartesianTrajectory &trajectory, double seed[6])
+{
+    SolverSet &s = getSolvers();
+    TrajectoryMatrix jointPos(6, trajectory.get_length());
+
+    // Samples are streamed from the trajectory, lazy ones are never stored
+    loadSeed(s.q_seed, seed);
+    int i = 0;
+    for (CartesianTrajectory::const_iterator it = trajectory.begin(); it != trajectory.end(); ++it, ++i)
+        solveSample(s, *it, i, jointPos, NULL, NULL);
+    return jointPos;
+}
+
+void RobotArm::solveTrajectory(const CartesianTrajectory &trajectory, double seed[6], TrajectoryMatrix &jointPos, TrajectoryMatrix &jointVel, TrajectoryMatrix &jointAcc)
+{
+    SolverSet &s = getSolvers();
+    int length = trajectory.get_length();
+    jointPos.resize(6, length);
+    jointVel.resize(6, length);
+    jointAcc.resize(6, length);
+
+    loadSeed(s.q_seed, seed);
+    int i = 0;
+    for (CartesianTrajectory::const_iterator it = trajectory.begin(); it != trajectory.end(); ++it, ++i)
+        solveSample(s, *it, i, jointPos, &jointVel, &jointAcc);
+}
+
+TrajectoryMatrix RobotArm::solveTrajectory(const CartesianTrajectory &trajectory, double seed[6], IKReport &report,
+                                           TrajectoryMatrix *jointVel, TrajectoryMatrix *jointAcc)
+{
+    SolverSet &s = getSolvers();
+    int length = trajectory.get_length();
+    TrajectoryMatrix jointPos(6, length);
+    if (jointVel != NULL && jointAcc != NULL)
+    {
+        jointVel->resize(6, length);
+        jointAcc->resize(6, length);
+    }
+    report = IKReport();
+    report.samples = length;
+
+    loadSeed(s.q_seed, seed);
+    int i = 0;
+    for (CartesianTrajectory::const_iterator it = trajectory.begin(); it != trajectory.end(); ++it, ++i)
+        solveSampleChecked(s, *it, i, jointPos, report, jointVel, jointAcc);
+    return jointPos;
+}
+
+void RobotArm::solveTrajectory(const CartesianTrajectory &trajectory, int begin, int end, double seed[6], TrajectoryMatrix &jointPos,
+                               IKReport &report, TrajectoryMatrix *jointVel, TrajectoryMatrix *jointAcc)
+{
+    SolverSet &s = getSolvers();
+    if (begin == 0)
+        loadSeed(s.q_seed, seed);
+    else
+        s.q_seed.data = jointPos.col(begin - 1);
+
+    report.samples += end - begin;
+    for (int i = begin; i < end; i++)
+        solveSampleChecked(s, trajectory.sampleAt(i), i, jointPos, report, jointVel, jointAcc);
+}
+
+void RobotArm::solveTrajectory(const CartesianTrajectory &trajectory, int begin, int end, double seed[6], TrajectoryMatrix &jointPos,
+                               TrajectoryMatrix *jointVel, TrajectoryMatrix *jointAcc)
+{
+    SolverSet &s = getSolvers();
+    if (begin == 0)
+        loadSeed(s.q_seed, seed);
+    else
+        s.q_seed.data = jointPos.col(begin - 1);
+
+    for (int i = begin; i < end; i++)
+        solveSample(s, trajectory.sampleAt(i), i, jointPos, jointVel, jointAcc);
+}
+
+Eigen::MatrixXd RobotArm::solvePath(const CartesianTrajectory &path, int points, double seed[6])
+{
+    SolverSet &s = getSolvers();
+    Eigen::MatrixXd jointPath(6, points);
+
+    loadSeed(s.q_seed, seed);
+    for (int i = 0; i < points; i++)
+    {
+        solvePosition(s, sampleFrame(path.pathSample((double)i / (points - 1))), s.q_seed, s.q_out);
+        jointPath.col(i) = s.q_out.data;
+        s.q_seed.data = s.q_out.data;
+    }
+    return jointPath;
+}
+
+TrajectoryMatrix RobotArm::solveTrajectoryParallel(const CartesianTrajectory &trajectory, double seed[6], int nThreads,
+                                                   TrajectoryMatrix *jointVel, TrajectoryMatrix *jointAcc)
+{
+    ThreadPool &pool = getThreadPool(nThreads);
+    int length = trajectory.get_length();
+    TrajectoryMatrix jointPos(6, length);
+    if (jointVel != NULL && jointAcc != NULL)
+    {
+        jointVel->resize(6, length);
+        jointAcc->resize(6, length);
+    }
+
+    // A few segments per thread, so that idle workers have something to steal
+    int segmentLength = std::max(8, length / (4 * pool.size()));
+
+    // Coarse serial pass on the segment starts keeps the whole path on the seed branch
+    SolverSet &s = getSolvers();
+    loadSeed(s.q_seed, seed);
+    for (int begin = 0; begin < length; begin += segmentLength)
+        solveSample(s, trajectory.sampleAt(begin), begin, jointPos, jointVel, jointAcc);
+
+    // Every segment is warm started from its coarse solution, columns are disjoint between tasks
+    ThreadPool::Batch batch;
+    for (int begin = 0; begin < length; begin += segmentLength)
+    {
+        int end = std::min(begin + segmentLength, length);
+        pool.submit([this, &trajectory, &jointPos, jointVel, jointAcc, begin, end]() {
+            SolverSet &ws = getSolvers();
+            ws.q_seed.data = jointPos.col(begin);
+            for (int i = begin + 1; i < end; i++)
+                solveSample(ws, trajectory.sampleAt(i), i, jointPos, jointVel, jointAcc);
+        }, batch);
+    }
+    pool.wait(batch);
+
+    return jointPos;
+}
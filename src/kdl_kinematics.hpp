@@ -20,17 +20,166 @@
 #include <Eigen/Geometry>
 #include <Eigen/Eigenvalues>
 
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "trajectory_types.hpp"
+#include "cartesian_trajectory.hpp"
+#include "ur5_kinematics.hpp"
+#include "seed_map.hpp"
+#include "thread_pool.hpp"
+
 //CLASS TO BUILD FORWARD AND INVERSE KINEMATICS
 class RobotArm
 {
+public:
+    // Position IK solvers
+    enum IKBackend
+    {
+        IK_LMA,     // iterative ChainIkSolverPos_LMA, any chain
+        IK_ANALYTIC // closed form, only for chains matching the UR5 geometry
+    };
+
+    // Bounds of a checked position IK solve, per sample
+    struct IKBudget
+    {
+        IKBudget() : maxIterations(500), maxTime(0.005), retries(3), tolerance(1e-3), jointRange(UR5Kinematics::JOINT_RANGE) {}
+
+        int maxIterations; // LMA iterations of every attempt
+        double maxTime;    // [s] over all the attempts, zero for no bound
+        int retries;       // attempts from other seeds when the first one does not converge
+        double tolerance;  // [m], [rad] largest pose error of an accepted solution, checked with FK
+        double jointRange; // [rad] joints are unwrapped next to the previous sample and checked against +-jointRange
+    };
+
+    // Quality of the IK of a whole trajectory
+    struct IKReport
+    {
+        IKReport() : samples(0), iterations(0), maxIterations(0), retried(0), maxResidual(0), maxTime(0) {}
+
+        int samples;
+        int iterations;           // LMA iterations over all the samples and attempts
+        int maxIterations;        // of the worst sample
+        int retried;              // samples solved again from another seed
+        double maxResidual;       // largest FK pose error of the solutions
+        double maxTime;           // [s] slowest sample
+        std::vector<int> rejected; // samples over tolerance, or outside the joint range after unwrapping
+    };
+
 private:
-    KDL::Tree my_tree;
-    KDL::Chain chain;
+    // KDL solvers keep internal buffers and are not reentrant, so every thread
+    // gets its own set, built once and reused for all the following calls
+    struct SolverSet
+    {
+        SolverSet(std::shared_ptr<const KDL::Chain> chain);
+
+        std::shared_ptr<const KDL::Chain> chain; // keeps the chain alive as long as the solvers
+        KDL::ChainFkSolverPos_recursive fk;
+        KDL::ChainIkSolverPos_LMA ik_p;
+        KDL::ChainIkSolverPos_LMA ik_slice; // few iterations per call, for the checked solves
+
+        // Checked solve attempts
+        KDL::JntArray q_try;
+        KDL::JntArray q_best;
+
+        // Scratch buffers
+        KDL::JntArray q_seed;
+        KDL::JntArray q_out;
+        KDL::Frame frame;
+    };
+
+    // Solver sets live in thread_local storage of the threads that use them, tagged with the pool of the arm
+    // they belong to, so that finding them takes no lock and they go away with their thread
+    struct SolverPool
+    {
+        std::once_flag threadsOnce;
+        std::unique_ptr<ThreadPool> threads; // built on the first parallel solve, then kept for the life of the arm
+    };
+
+    // Shared between copies of the same arm, solvers refer to the chain by reference
+    std::shared_ptr<KDL::Chain> chain;
+    std::shared_ptr<SolverPool> solvers;
+
+    // Closed form model fitted on the chain, null when the chain is not a UR5
+    std::shared_ptr<const UR5Kinematics> analytic;
+    IKBackend backend;
+    IKBudget budget;
+
+    // Workspace seeds for the single pose IK, null when not loaded
+    std::shared_ptr<const SeedMap> seedMap;
+
+    static std::shared_ptr<UR5Kinematics> fitAnalyticModel(const KDL::Chain &chain);
+    static std::string readRobotDescription(ros::NodeHandle &nh_);
+    SolverSet &getSolvers();
+    ThreadPool &getThreadPool(int nThreads);
+    void loadSeed(KDL::JntArray &q, double joints[6]);
+    static KDL::Frame targetFrame(double X, double Y, double Z, double roll, double pitch, double yaw);
+    static KDL::Frame sampleFrame(const CartesianSample &sample);
+    bool mapSeed(SolverSet &s, const KDL::Frame &target, KDL::JntArray &seed);
+    int solvePosition(SolverSet &s, const KDL::Frame &target, const KDL::JntArray &seed, KDL::JntArray &q_out);
+    static void operationalTwist(const Vector6d &pose, const Vector6d &velocity, const Vector6d &acceleration, Vector6d &twist, Vector6d &twistDot);
+    static void sampleTwist(const CartesianSample &sample, Vector6d &twist, Vector6d &twistDot);
+    void solveDerivatives(const KDL::JntArray &q, const Vector6d &twist, const Vector6d &twistDot, Vector6d &qd, Vector6d &qdd) const;
+    void solveSample(SolverSet &s, const CartesianSample &sample, int i, TrajectoryMatrix &jointPos, TrajectoryMatrix *jointVel, TrajectoryMatrix *jointAcc);
+    double poseResidual(SolverSet &s, const KDL::JntArray &q, const KDL::Frame &target);
+    double solveChecked(SolverSet &s, const KDL::Frame &target, const KDL::JntArray &seed, KDL::JntArray &q_out, IKReport &report);
+    void solveSampleChecked(SolverSet &s, const CartesianSample &sample, int i, TrajectoryMatrix &jointPos, IKReport &report,
+                            TrajectoryMatrix *jointVel, TrajectoryMatrix *jointAcc);
 
 public:
-    RobotArm(ros::NodeHandle nh_);
+    RobotArm(ros::NodeHandle &nh_);
+    explicit RobotArm(const std::string &robot_desc_string);
+    const KDL::Chain &getChain() const;
+    bool setIKBackend(IKBackend backend);
+    IKBackend getIKBackend() const;
+    const UR5Kinematics *getAnalyticModel() const;
+    void setIKBudget(const IKBudget &budget);
+    const IKBudget &getIKBudget() const;
+    // Seeds of IKinematics from a map built for the same UR5 model; false, and no map, otherwise
+    bool setSeedMap(std::shared_ptr<const SeedMap> seedMap);
+    // Joint positions in chain order back to the joint_states order of the seeds
+    static void toSeed(const Vector6d &q, double joints[6]);
+
     KDL::Frame FKinematics(double joints[6]);
-    KDL::JntArray IKinematics(double X, double Y, double Z, double roll, double pitch, double yaw, double joints[6], Eigen::MatrixXd &operational_velocities, int pos, Eigen::MatrixXd &operational_acc, int length, double vel_[6], double acc_[6]);
+    KDL::JntArray IKinematics(double X, double Y, double Z, double roll, double pitch, double yaw, double joints[6], const TrajectoryMatrix &operational_velocities, int pos, const TrajectoryMatrix &operational_acc, int length, double vel_[6], double acc_[6]);
+    // Position IK of a target frame, seeded with joints in joint_states order; the solution is in chain order
+    KDL::JntArray IKinematics(const KDL::Frame &target, double joints[6]);
+
+    // Joint positions (6, length) of a whole trajectory, each sample seeded with the previous solution
+    TrajectoryMatrix solveTrajectory(const CartesianTrajectory &trajectory, double seed[6]);
+
+    // Joint positions, velocities and accelerations (6, length) of a whole trajectory; the Jacobian of every
+    // solution is built once and used for the velocities and, with dJ/dt * qd, for the accelerations
+    void solveTrajectory(const CartesianTrajectory &trajectory, double seed[6], TrajectoryMatrix &jointPos, TrajectoryMatrix &jointVel, TrajectoryMatrix &jointAcc);
+
+    // Checked solve within the IK budget: every sample is verified with FK and solved again from other seeds
+    // (wrapped joints, the closed form solution, perturbations) while the budget allows; joints are unwrapped
+    // next to the previous sample instead of being left out, and the quality of the whole solve goes in report
+    TrajectoryMatrix solveTrajectory(const CartesianTrajectory &trajectory, double seed[6], IKReport &report,
+                                     TrajectoryMatrix *jointVel = NULL, TrajectoryMatrix *jointAcc = NULL);
+
+    // Samples [begin, end) only, written in the same columns of jointPos (6, length) and of jointVel and jointAcc
+    // when given; the first one is warm started from column begin - 1, or from seed when begin is zero
+    void solveTrajectory(const CartesianTrajectory &trajectory, int begin, int end, double seed[6], TrajectoryMatrix &jointPos,
+                         TrajectoryMatrix *jointVel = NULL, TrajectoryMatrix *jointAcc = NULL);
+
+    // Checked solve of the samples [begin, end) only, as the one above; the quality is added to report, so a
+    // trajectory solved in chunks has one report
+    void solveTrajectory(const CartesianTrajectory &trajectory, int begin, int end, double seed[6], TrajectoryMatrix &jointPos,
+                         IKReport &report, TrajectoryMatrix *jointVel = NULL, TrajectoryMatrix *jointAcc = NULL);
+
+    // Joint positions (6, points) at evenly spaced abscissae of the path, from s = 0 to s = 1, as input for a PathTimingLaw
+    Eigen::MatrixXd solvePath(const CartesianTrajectory &path, int points, double seed[6]);
+
+    // Same result split in segments solved on a thread pool (nThreads zero means one per core; the pool is sized
+    // by the first parallel solve of the arm and its copies), every segment seeded from a coarse serial pass over
+    // the segment starts; velocities and accelerations are written in jointVel and jointAcc when given.
+    // Concurrent calls share the pool and each waits only for its own segments
+    TrajectoryMatrix solveTrajectoryParallel(const CartesianTrajectory &trajectory, double seed[6], int nThreads = 0,
+                                             TrajectoryMatrix *jointVel = NULL, TrajectoryMatrix *jointAcc = NULL);
 };
 
 #endif
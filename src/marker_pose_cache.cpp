@@ -0,0 +1,94 @@
+#include "marker_pose_cache.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+// Constructor
+MarkerPoseCache::MarkerPoseCache(const MarkerPoseFilter::Parameters &filterParameters)
+    : filterParameters(filterParameters)
+{
+}
+
+void MarkerPoseCache::setFilterParameters(const MarkerPoseFilter::Parameters &filterParameters)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    this->filterParameters = filterParameters;
+}
+
+void MarkerPoseCache::update(int id, const MarkerPose &pose)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        EntryMap::iterator it = entries.find(id);
+        if (it == entries.end())
+            it = entries.insert(std::make_pair(id, Entry(filterParameters))).first;
+
+        Entry &entry = it->second;
+        Eigen::Isometry3d basePose = entry.pose.basePose;
+        bool hasBasePose = entry.pose.hasBasePose;
+        entry.pose = pose;
+
+        // Without the camera pose the filtered base pose of the previous detections is kept
+        if (pose.hasBasePose)
+        {
+            entry.filter.update(pose.stamp, pose.basePose);
+            entry.pose.basePose = entry.filter.getPose();
+        }
+        else
+        {
+            entry.pose.basePose = basePose;
+            entry.pose.hasBasePose = hasBasePose;
+        }
+        entry.pose.positionVariance = entry.filter.getPositionVariance();
+        entry.pose.orientationVariance = entry.filter.getOrientationVariance();
+        entry.pose.samples = entry.filter.getSamples();
+        entry.pose.converged = entry.filter.isConverged();
+    }
+    updated.notify_all();
+}
+
+bool MarkerPoseCache::isReady(const MarkerPose &pose, double maxAge, bool converged) const
+{
+    return pose.hasBasePose && (!converged || pose.converged) && (ros::Time::now() - pose.stamp).toSec() <= maxAge;
+}
+
+bool MarkerPoseCache::waitForMarker(int id, double maxAge, double timeout, MarkerPose &pose, bool converged) const
+{
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(timeout));
+
+    std::unique_lock<std::mutex> lock(mutex);
+    bool found = updated.wait_until(lock, deadline, [&] {
+        EntryMap::const_iterator it = entries.find(id);
+        return it != entries.end() && isReady(it->second.pose, maxAge, converged);
+    });
+    if (found)
+        pose = entries.find(id)->second.pose;
+    return found;
+}
+
+bool MarkerPoseCache::get(int id, MarkerPose &pose) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    EntryMap::const_iterator it = entries.find(id);
+    if (it == entries.end())
+        return false;
+    pose = it->second.pose;
+    return true;
+}
+
+std::vector<int> MarkerPoseCache::getIds() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<int> ids;
+    for (EntryMap::const_iterator it = entries.begin(); it != entries.end(); ++it)
+        ids.push_back(it->first);
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+void MarkerPoseCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+}
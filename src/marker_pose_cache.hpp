@@ -0,0 +1,80 @@
+#ifndef MARKER_POSE_CACHE
+#define MARKER_POSE_CACHE
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <ros/ros.h>
+#include <Eigen/Geometry>
+
+#include "marker_pose_filter.hpp"
+
+// Last pose of a marker
+struct MarkerPose
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    ros::Time stamp;              // of the camera frame it was last detected in
+    Eigen::Isometry3d cameraPose; // in the camera optical frame, as detected
+    Eigen::Isometry3d basePose;   // in the robot base frame, filtered over time; valid only if hasBasePose
+    bool hasBasePose;
+
+    // Uncertainty of basePose
+    Eigen::Vector3d positionVariance;
+    double orientationVariance;
+    int samples;
+    bool converged;
+};
+
+//CLASS TO KEEP THE LAST POSE OF EVERY MARKER, SHARED BETWEEN THE DETECTOR AND THE TASK
+//the task reads the poses directly instead of looking them up in tf, or waits for a fresh one;
+//base frame poses go through a MarkerPoseFilter per marker
+class MarkerPoseCache
+{
+private:
+    struct Entry
+    {
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        explicit Entry(const MarkerPoseFilter::Parameters &parameters) : filter(parameters) {}
+
+        MarkerPose pose;
+        MarkerPoseFilter filter;
+    };
+
+    typedef std::unordered_map<int, Entry, std::hash<int>, std::equal_to<int>,
+                               Eigen::aligned_allocator<std::pair<const int, Entry>>> EntryMap;
+
+    MarkerPoseFilter::Parameters filterParameters;
+
+    mutable std::mutex mutex;
+    mutable std::condition_variable updated;
+    EntryMap entries;
+
+    bool isReady(const MarkerPose &pose, double maxAge, bool converged) const;
+
+public:
+    // Constructor
+    explicit MarkerPoseCache(const MarkerPoseFilter::Parameters &filterParameters = MarkerPoseFilter::Parameters());
+
+    // Used by the filters of the markers seen from now on
+    void setFilterParameters(const MarkerPoseFilter::Parameters &filterParameters);
+
+    // Stores a detection, its base frame pose is filtered with the previous ones
+    void update(int id, const MarkerPose &pose);
+
+    // False if the marker has never been seen
+    bool get(int id, MarkerPose &pose) const;
+
+    // Blocks until the marker has a base frame pose at most maxAge seconds old (ROS time), and
+    // a converged one if required; false if none arrives within timeout seconds (wall time)
+    bool waitForMarker(int id, double maxAge, double timeout, MarkerPose &pose, bool converged = false) const;
+
+    std::vector<int> getIds() const;
+    void clear();
+};
+
+#endif
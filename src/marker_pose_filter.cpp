@@ -0,0 +1,97 @@
+#include "marker_pose_filter.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+MarkerPoseFilter::Parameters::Parameters()
+    : positionNoise(0.01), orientationNoise(0.05), positionDrift(0.002), orientationDrift(0.01),
+      convergedStd(0.003), minSamples(5), gate(5), maxOutliers(5)
+{
+}
+
+// Constructor
+MarkerPoseFilter::MarkerPoseFilter(const Parameters &parameters)
+    : parameters(parameters), initialized(false), orientationVariance(0), samples(0), outliers(0)
+{
+    position.setZero();
+    orientation.setIdentity();
+    positionVariance.setZero();
+}
+
+void MarkerPoseFilter::reset(const ros::Time &stamp, const Eigen::Isometry3d &measurement)
+{
+    initialized = true;
+    last = stamp;
+    position = measurement.translation();
+    orientation = Eigen::Quaterniond(measurement.rotation());
+    positionVariance.setConstant(parameters.positionNoise * parameters.positionNoise);
+    orientationVariance = parameters.orientationNoise * parameters.orientationNoise;
+    samples = 1;
+    outliers = 0;
+}
+
+bool MarkerPoseFilter::update(const ros::Time &stamp, const Eigen::Isometry3d &measurement)
+{
+    if (!initialized)
+    {
+        reset(stamp, measurement);
+        return true;
+    }
+
+    // Prediction, the pose stays the same and its uncertainty grows with time
+    double dt = std::max(0.0, (stamp - last).toSec());
+    positionVariance.array() += parameters.positionDrift * parameters.positionDrift * dt;
+    orientationVariance += parameters.orientationDrift * parameters.orientationDrift * dt;
+
+    // Gate on the position innovation, several outliers in a row mean the marker has moved
+    Eigen::Vector3d innovation = measurement.translation() - position;
+    Eigen::Vector3d S = positionVariance.array() + parameters.positionNoise * parameters.positionNoise;
+    if ((innovation.array().square() / S.array()).maxCoeff() > parameters.gate * parameters.gate)
+    {
+        if (++outliers >= parameters.maxOutliers)
+        {
+            reset(stamp, measurement);
+            return true;
+        }
+        return false;
+    }
+    outliers = 0;
+
+    // Position correction, axes are independent
+    Eigen::Vector3d K = positionVariance.cwiseQuotient(S);
+    position += K.cwiseProduct(innovation);
+    positionVariance = (Eigen::Vector3d::Ones() - K).cwiseProduct(positionVariance);
+
+    // Orientation correction, normalized weighted average on the same hemisphere as the estimate
+    Eigen::Quaterniond q(measurement.rotation());
+    if (orientation.dot(q) < 0)
+        q.coeffs() = -q.coeffs();
+    double k = orientationVariance / (orientationVariance + parameters.orientationNoise * parameters.orientationNoise);
+    orientation.coeffs() += k * (q.coeffs() - orientation.coeffs());
+    orientation.normalize();
+    orientationVariance *= 1 - k;
+
+    last = stamp;
+    samples++;
+    return true;
+}
+
+// GETTERS
+
+Eigen::Isometry3d MarkerPoseFilter::getPose() const
+{
+    Eigen::Isometry3d pose = Eigen::Isometry3d::Identity();
+    pose.linear() = orientation.toRotationMatrix();
+    pose.translation() = position;
+    return pose;
+}
+
+const Eigen::Vector3d &MarkerPoseFilter::getPositionVariance() const { return positionVariance; }
+double MarkerPoseFilter::getOrientationVariance() const { return orientationVariance; }
+int MarkerPoseFilter::getSamples() const { return samples; }
+
+bool MarkerPoseFilter::isConverged() const
+{
+    return samples >= parameters.minSamples &&
+           positionVariance.maxCoeff() < parameters.convergedStd * parameters.convergedStd;
+}
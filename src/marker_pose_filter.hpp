@@ -0,0 +1,60 @@
+#ifndef MARKER_POSE_FILTER
+#define MARKER_POSE_FILTER
+
+#include <ros/ros.h>
+#include <Eigen/Geometry>
+
+//CLASS TO FILTER THE POSE OF A MARKER THAT DOES NOT MOVE
+//constant pose Kalman filter with a variance per position axis and one for the orientation;
+//the orientation estimate is a running quaternion average weighted by the Kalman gain.
+//Every measurement costs the same, whatever the number of measurements seen before
+class MarkerPoseFilter
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    struct Parameters
+    {
+        double positionNoise;    // std of a single position measurement [m]
+        double orientationNoise; // std of a single orientation measurement [rad]
+        double positionDrift;    // process noise, lets the estimate follow slow motions [m/sqrt(s)]
+        double orientationDrift; // [rad/sqrt(s)]
+        double convergedStd;     // position std under which the estimate is considered stable [m]
+        int minSamples;          // measurements needed before the estimate is considered stable
+        double gate;             // measurements farther than gate std are outliers
+        int maxOutliers;         // consecutive outliers after which the marker is assumed moved
+
+        // Defaults for the wrist camera at about half a meter
+        Parameters();
+    };
+
+private:
+    Parameters parameters;
+
+    bool initialized;
+    ros::Time last;
+    Eigen::Vector3d position;
+    Eigen::Quaterniond orientation;
+    Eigen::Vector3d positionVariance;
+    double orientationVariance;
+    int samples;
+    int outliers;
+
+    void reset(const ros::Time &stamp, const Eigen::Isometry3d &measurement);
+
+public:
+    // Constructor
+    explicit MarkerPoseFilter(const Parameters &parameters = Parameters());
+
+    // Adds a measurement, false if it was rejected as an outlier
+    bool update(const ros::Time &stamp, const Eigen::Isometry3d &measurement);
+
+    // Getters
+    Eigen::Isometry3d getPose() const;
+    const Eigen::Vector3d &getPositionVariance() const;
+    double getOrientationVariance() const;
+    int getSamples() const;
+    bool isConverged() const;
+};
+
+#endif
@@ -0,0 +1,143 @@
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+std::atomic<bool> Metrics::enabled(false);
+
+namespace
+{
+struct HistogramData
+{
+    std::atomic<uint64_t> buckets[Metrics::BUCKETS];
+    std::atomic<uint64_t> count;
+    std::atomic<double> sum;
+    std::atomic<double> max;
+};
+
+// Zero initialized as static storage
+HistogramData histograms[Metrics::HISTOGRAM_COUNT];
+std::atomic<uint64_t> counters[Metrics::COUNTER_COUNT];
+
+const char *HISTOGRAM_NAMES[Metrics::HISTOGRAM_COUNT] = {
+    "ik_sample_us",
+    "ik_iterations",
+    "ik_residual",
+    "trajectory_sample_us",
+    "detection_us",
+    "tf_lookup_us",
+    "planning_us",
+    "goal_execution_us"};
+
+const char *COUNTER_NAMES[Metrics::COUNTER_COUNT] = {
+    "ik_solves",
+    "ik_seed_hits",
+    "ik_seed_map_hits",
+    "ik_errors",
+    "frames_received",
+    "frames_dropped",
+    "markers_detected",
+    "goals_sent"};
+
+int bucketOf(double value)
+{
+    if (!(value > 0))
+        return 0;
+    int exponent;
+    std::frexp(value, &exponent);
+    return std::min(std::max(exponent + Metrics::BUCKET_OFFSET, 0), Metrics::BUCKETS - 1);
+}
+}
+
+void Metrics::setEnabled(bool enabled)
+{
+    Metrics::enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void Metrics::record(Histogram id, double value)
+{
+    if (!isEnabled())
+        return;
+
+    HistogramData &h = histograms[id];
+    h.buckets[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+    h.count.fetch_add(1, std::memory_order_relaxed);
+
+    double sum = h.sum.load(std::memory_order_relaxed);
+    while (!h.sum.compare_exchange_weak(sum, sum + value, std::memory_order_relaxed))
+        ;
+    double max = h.max.load(std::memory_order_relaxed);
+    while (value > max && !h.max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+        ;
+}
+
+void Metrics::count(Counter id, uint64_t n)
+{
+    if (isEnabled())
+        counters[id].fetch_add(n, std::memory_order_relaxed);
+}
+
+void Metrics::writeCsvHeader(std::ostream &out)
+{
+    out << "time,metric,count,mean,p50,p90,p99,max\n";
+}
+
+void Metrics::writeCsv(std::ostream &out, double time)
+{
+    for (int i = 0; i < HISTOGRAM_COUNT; i++)
+    {
+        Histogram id = (Histogram)i;
+        out << time << "," << HISTOGRAM_NAMES[i] << "," << getCount(id) << "," << getMean(id) << "," << getPercentile(id, 0.5) << ","
+            << getPercentile(id, 0.9) << "," << getPercentile(id, 0.99) << "," << getMax(id) << "\n";
+    }
+    for (int i = 0; i < COUNTER_COUNT; i++)
+        out << time << "," << COUNTER_NAMES[i] << "," << getCount((Counter)i) << ",,,,,\n";
+}
+
+void Metrics::reset()
+{
+    for (int i = 0; i < HISTOGRAM_COUNT; i++)
+    {
+        for (int k = 0; k < BUCKETS; k++)
+            histograms[i].buckets[k].store(0, std::memory_order_relaxed);
+        histograms[i].count.store(0, std::memory_order_relaxed);
+        histograms[i].sum.store(0, std::memory_order_relaxed);
+        histograms[i].max.store(0, std::memory_order_relaxed);
+    }
+    for (int i = 0; i < COUNTER_COUNT; i++)
+        counters[i].store(0, std::memory_order_relaxed);
+}
+
+// GETTERS
+
+uint64_t Metrics::getCount(Counter id) { return counters[id].load(std::memory_order_relaxed); }
+uint64_t Metrics::getCount(Histogram id) { return histograms[id].count.load(std::memory_order_relaxed); }
+double Metrics::getMax(Histogram id) { return histograms[id].max.load(std::memory_order_relaxed); }
+
+double Metrics::getMean(Histogram id)
+{
+    uint64_t n = getCount(id);
+    return n > 0 ? histograms[id].sum.load(std::memory_order_relaxed) / n : 0;
+}
+
+double Metrics::getPercentile(Histogram id, double p)
+{
+    // Buckets are read one by one while others may record, the total is taken from them for consistency
+    uint64_t counts[BUCKETS], total = 0;
+    for (int k = 0; k < BUCKETS; k++)
+    {
+        counts[k] = histograms[id].buckets[k].load(std::memory_order_relaxed);
+        total += counts[k];
+    }
+    if (total == 0)
+        return 0;
+
+    uint64_t rank = std::max<uint64_t>(1, (uint64_t)std::ceil(p * total)), seen = 0;
+    for (int k = 0; k < BUCKETS; k++)
+    {
+        seen += counts[k];
+        if (seen >= rank)
+            return std::min(std::ldexp(1.0, k - BUCKET_OFFSET), getMax(id));
+    }
+    return getMax(id);
+}
@@ -0,0 +1,101 @@
+#ifndef METRICS
+#define METRICS
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+//CLASS FOR PROCESS WIDE METRICS OF THE HOT PATHS
+//counters and histograms are fixed arrays of atomics updated with relaxed operations, so recording never
+//locks or allocates and any thread can export them at any time; histograms have one bucket per power of two.
+//Everything is off until enabled, then a disabled timer costs one relaxed load
+class Metrics
+{
+public:
+    enum Histogram
+    {
+        IK_SAMPLE_TIME,         // [us] position IK of one pose
+        IK_ITERATIONS,          // LMA iterations of one pose
+        IK_RESIDUAL,            // LMA residual of one pose
+        TRAJECTORY_SAMPLE_TIME, // [us] evaluation of one operational space sample
+        DETECTION_TIME,         // [us] marker detection on one frame
+        TF_LOOKUP_TIME,         // [us] transform lookup
+        PLANNING_TIME,          // [us] planning of one goal, IK included
+        GOAL_EXECUTION_TIME,    // [us] from sending a goal to its result
+        HISTOGRAM_COUNT
+    };
+
+    enum Counter
+    {
+        IK_SOLVES,        // position IK calls
+        IK_SEED_HITS,     // poses already reached by the seed, LMA skipped
+        IK_SEED_MAP_HITS, // single pose solves started from the seed map instead of the given seed
+        IK_ERRORS,        // LMA calls returning an error
+        FRAMES_RECEIVED,  // camera frames received
+        FRAMES_DROPPED,   // frames replaced by a newer one before the detector took them
+        MARKERS_DETECTED, // markers found over all frames
+        GOALS_SENT,       // trajectory goals sent to the controller
+        COUNTER_COUNT
+    };
+
+    enum
+    {
+        BUCKETS = 64,     // bucket k holds values in [2^(k - BUCKET_OFFSET - 1), 2^(k - BUCKET_OFFSET))
+        BUCKET_OFFSET = 32
+    };
+
+    typedef std::chrono::steady_clock Clock;
+
+    // Records the time from construction to destruction in a histogram, in microseconds
+    class ScopedTimer
+    {
+    private:
+        Histogram id;
+        bool active;
+        Clock::time_point start;
+
+    public:
+        explicit ScopedTimer(Histogram id) : id(id), active(isEnabled())
+        {
+            if (active)
+                start = Clock::now();
+        }
+        ~ScopedTimer()
+        {
+            if (active)
+                record(id, std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+        }
+        ScopedTimer(const ScopedTimer &) = delete;
+        ScopedTimer &operator=(const ScopedTimer &) = delete;
+    };
+
+    static void setEnabled(bool enabled);
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+    // Both do nothing while disabled
+    static void record(Histogram id, double value);
+    static void count(Counter id, uint64_t n = 1);
+
+    // Snapshot of the values recorded since the start or the last reset, one row per metric:
+    // time,metric,count,mean,p50,p90,p99,max (counters fill in count only); time is given by the caller
+    static void writeCsvHeader(std::ostream &out);
+    static void writeCsv(std::ostream &out, double time);
+
+    static void reset();
+
+    // Getters
+    static uint64_t getCount(Counter id);
+    static uint64_t getCount(Histogram id);
+    static double getMean(Histogram id);
+    static double getMax(Histogram id);
+    // Upper bound of the bucket holding the p quantile, p in [0, 1]
+    static double getPercentile(Histogram id, double p);
+
+private:
+    static std::atomic<bool> enabled;
+
+    Metrics() = delete;
+};
+
+#endif
@@ -0,0 +1,170 @@
+#include "path_timing_law.hpp"
+
+#define _USE_MATH_DEFINES // For PI costants
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+// Joint derivatives this small do not constrain the abscissa
+static const double PATH_EPS = 1e-9;
+
+// Bound on (ds/dt)^2 where no joint constrains it, e.g. a path that does not move
+static const double PATH_X_MAX = 1e12;
+
+const double JointLimits::DEFAULT_SCALE = 0.5;
+
+JointLimits JointLimits::UR5()
+{
+    JointLimits limits;
+    limits.velocity = Eigen::VectorXd::Constant(6, M_PI);
+    limits.acceleration = Eigen::VectorXd::Constant(6, 1.4);
+    return limits;
+}
+
+JointLimits JointLimits::scaled(double velocityScale, double accelerationScale) const
+{
+    JointLimits limits;
+    limits.velocity = velocity * velocityScale;
+    limits.acceleration = acceleration * accelerationScale;
+    return limits;
+}
+
+// Constructor
+PathTimingLaw::PathTimingLaw(const Eigen::MatrixXd &path, const JointLimits &limits)
+{
+    int points = path.cols();
+    int last = points - 1;
+    ds = 1.0 / last;
+
+    // Path derivatives with respect to s, central differences inside, one sided at the ends
+    Eigen::MatrixXd dq(path.rows(), points), ddq(path.rows(), points);
+    for (int i = 0; i < points; i++)
+    {
+        int prev = std::max(i - 1, 0), next = std::min(i + 1, last);
+        dq.col(i) = (path.col(next) - path.col(prev)) / ((next - prev) * ds);
+        if (points > 2)
+        {
+            int c = std::min(std::max(i, 1), last - 1);
+            ddq.col(i) = (path.col(c + 1) - 2 * path.col(c) + path.col(c - 1)) / (ds * ds);
+        }
+        else
+            ddq.col(i).setZero();
+    }
+
+    // Largest (ds/dt)^2 allowed at every grid point
+    std::vector<double> xMax(points);
+    for (int i = 0; i < points; i++)
+        xMax[i] = maxVelocitySquared(dq.col(i), ddq.col(i), limits);
+
+    // Backward pass, largest state from which the rest of the path can still stop at the end
+    std::vector<double> reachable(points);
+    reachable[last] = 0;
+    for (int i = last - 1; i >= 0; i--)
+    {
+        // x + 2 ds u_min(x) is convex in x, so the states that can decelerate enough are an interval from 0
+        double lo = 0, hi = xMax[i];
+        for (int k = 0; k < 60; k++)
+        {
+            double x = 0.5 * (lo + hi), lower, upper;
+            accelerationBounds(dq.col(i), ddq.col(i), limits, x, lower, upper);
+            if (lower <= upper && x + 2 * ds * lower <= reachable[i + 1])
+                lo = x;
+            else
+                hi = x;
+        }
+        reachable[i] = lo;
+    }
+
+    // Forward pass, greedy acceleration bounded by the reachable states
+    std::vector<double> x(points);
+    x[0] = 0;
+    for (int i = 0; i < last; i++)
+    {
+        double lower, upper;
+        accelerationBounds(dq.col(i), ddq.col(i), limits, x[i], lower, upper);
+        x[i + 1] = std::max(0.0, std::min(reachable[i + 1], x[i] + 2 * ds * upper));
+    }
+
+    // Time of every grid point, constant acceleration between them
+    t.resize(points);
+    sd.resize(points);
+    sdd.resize(last);
+    t[0] = 0;
+    for (int i = 0; i < points; i++)
+        sd[i] = std::sqrt(x[i]);
+    for (int i = 0; i < last; i++)
+    {
+        sdd[i] = (x[i + 1] - x[i]) / (2 * ds);
+        t[i + 1] = t[i] + 2 * ds / (sd[i] + sd[i + 1]);
+    }
+}
+
+void PathTimingLaw::accelerationBounds(const Eigen::VectorXd &dq, const Eigen::VectorXd &ddq, const JointLimits &limits, double x, double &lower, double &upper)
+{
+    // Joint acceleration is dq u + ddq x, bounded by the acceleration limit
+    lower = -std::numeric_limits<double>::infinity();
+    upper = std::numeric_limits<double>::infinity();
+    for (int j = 0; j < dq.rows(); j++)
+    {
+        double a = limits.acceleration(j);
+        if (std::abs(dq(j)) < PATH_EPS)
+        {
+            if (std::abs(ddq(j)) * x > a)
+            {
+                lower = 1;
+                upper = 0;
+                return;
+            }
+            continue;
+        }
+        double b1 = (-a - ddq(j) * x) / dq(j), b2 = (a - ddq(j) * x) / dq(j);
+        lower = std::max(lower, std::min(b1, b2));
+        upper = std::min(upper, std::max(b1, b2));
+    }
+}
+
+double PathTimingLaw::maxVelocitySquared(const Eigen::VectorXd &dq, const Eigen::VectorXd &ddq, const JointLimits &limits)
+{
+    // Velocity limits, joint velocity is dq sd
+    double xMax = PATH_X_MAX;
+    for (int j = 0; j < dq.rows(); j++)
+        if (std::abs(dq(j)) >= PATH_EPS)
+            xMax = std::min(xMax, std::pow(limits.velocity(j) / dq(j), 2));
+
+    // Acceleration limits, the feasible accelerations shrink as x grows and vanish past a point
+    double lower, upper;
+    accelerationBounds(dq, ddq, limits, xMax, lower, upper);
+    if (lower <= upper)
+        return xMax;
+
+    double lo = 0, hi = xMax;
+    for (int k = 0; k < 60; k++)
+    {
+        double x = 0.5 * (lo + hi);
+        accelerationBounds(dq, ddq, limits, x, lower, upper);
+        if (lower <= upper)
+            lo = x;
+        else
+            hi = x;
+    }
+    return lo;
+}
+
+void PathTimingLaw::evaluate(double time, double &s, double &sdOut, double &sddOut) const
+{
+    time = std::min(std::max(time, 0.0), t.back());
+
+    // Segment containing the time
+    int i = std::upper_bound(t.begin(), t.end(), time) - t.begin() - 1;
+    i = std::min(std::max(i, 0), (int)sdd.size() - 1);
+
+    double tau = time - t[i];
+    s = std::min(i * ds + sd[i] * tau + 0.5 * sdd[i] * tau * tau, 1.0);
+    sdOut = sd[i] + sdd[i] * tau;
+    sddOut = sdd[i];
+}
+
+// GETTERS
+
+double PathTimingLaw::getDuration() const { return t.back(); }
+int PathTimingLaw::getPoints() const { return t.size(); }
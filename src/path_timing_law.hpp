@@ -0,0 +1,57 @@
+#ifndef PATH_TIMING_LAW
+#define PATH_TIMING_LAW
+
+#include <Eigen/Eigen>
+#include <Eigen/Dense>
+
+#include <vector>
+
+// Symmetric velocity and acceleration bounds of every joint
+struct JointLimits
+{
+    Eigen::VectorXd velocity;     // [rad/s]
+    Eigen::VectorXd acceleration; // [rad/s^2]
+
+    // Share of the UR5 limits used by the task unless configured otherwise, leaves a margin for the acceleration
+    // overshoot of PathTimingLaw between grid points and for the controller
+    static const double DEFAULT_SCALE;
+
+    // UR5 datasheet joint speed, 180 deg/s. The datasheet gives no joint acceleration: the value is the default
+    // joint acceleration of the UR controller for joint moves, a conservative guess rather than a hardware limit
+    static JointLimits UR5();
+
+    // Same limits times the scales, which are expected in (0, 1]
+    JointLimits scaled(double velocityScale, double accelerationScale) const;
+};
+
+//CLASS FOR TIME OPTIMAL TIMING LAWS ALONG A GEOMETRIC PATH
+//the path is given as joint positions at evenly spaced values of the normalized abscissa s in [0, 1];
+//the law s(t) is the fastest one that starts and ends at rest without exceeding the joint limits,
+//found by reachability analysis on the path grid (a backward pass for the states from which the end
+//can still be reached, a forward pass taking the largest acceleration that stays in them).
+//Between two grid points the acceleration of s is constant
+class PathTimingLaw
+{
+private:
+    double ds;                 // grid step of s
+    std::vector<double> t;     // time at every grid point
+    std::vector<double> sd;    // ds/dt at every grid point
+    std::vector<double> sdd;   // d2s/dt2 between grid point i and i + 1
+
+    // Feasible d2s/dt2 at a grid point for a given (ds/dt)^2, empty when lower > upper
+    static void accelerationBounds(const Eigen::VectorXd &dq, const Eigen::VectorXd &ddq, const JointLimits &limits, double x, double &lower, double &upper);
+    static double maxVelocitySquared(const Eigen::VectorXd &dq, const Eigen::VectorXd &ddq, const JointLimits &limits);
+
+public:
+    // Constructor, path is (joints, points) with points >= 3
+    PathTimingLaw(const Eigen::MatrixXd &path, const JointLimits &limits);
+
+    // Abscissa, its velocity and acceleration at time t, clamped to the duration
+    void evaluate(double t, double &s, double &sd, double &sdd) const;
+
+    // Getters
+    double getDuration() const;
+    int getPoints() const;
+};
+
+#endif
@@ -0,0 +1,220 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+#include <Eigen/Eigen>
+
+#include "kdl_kinematics.hpp"
+#include "cartesian_trajectory.hpp"
+#include "joint_pol_traj.hpp"
+#include "path_timing_law.hpp"
+#include "thread_pool.hpp"
+#include "trajectory_file.hpp"
+
+using namespace Eigen;
+
+typedef std::chrono::steady_clock Clock;
+
+// Move of the task, planned from the seed of the previous moves
+struct Move
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    std::string name;
+    PlannedSegment::Type type;
+    Vector6d start, end;
+    double duration; // zero for the time optimal law
+    double seed[6];  // joint_states order
+};
+
+typedef std::vector<Move, Eigen::aligned_allocator<Move>> MoveList;
+
+// Task description, one statement per line, '#' starts a comment:
+//   Ts <seconds>                                          sampling time of every move
+//   seed <6 joint positions>                              arm configuration before the first move, joint_states order
+//   pose <name> <x> <y> <z> <roll> <pitch> <yaw>          named end effector pose
+//   linear <from> <to> <duration | optimal>               operational space move between two poses
+//   joint <from> <to> <duration | optimal>                joint space move between two poses
+static bool readTask(const std::string &fileName, double &Ts, double seed[6], MoveList &moves)
+{
+    std::ifstream task(fileName.c_str());
+    if (!task)
+    {
+        std::cerr << "Cannot open " << fileName << std::endl;
+        return false;
+    }
+
+    std::map<std::string, Vector6d, std::less<std::string>, Eigen::aligned_allocator<std::pair<const std::string, Vector6d>>> poses;
+    std::string line;
+    for (int number = 1; std::getline(task, line); number++)
+    {
+        std::istringstream in(line.substr(0, line.find('#')));
+        std::string keyword;
+        if (!(in >> keyword))
+            continue;
+
+        bool ok = true;
+        if (keyword == "Ts")
+            ok = (bool)(in >> Ts);
+        else if (keyword == "seed")
+            ok = (bool)(in >> seed[0] >> seed[1] >> seed[2] >> seed[3] >> seed[4] >> seed[5]);
+        else if (keyword == "pose")
+        {
+            std::string name;
+            Vector6d pose;
+            ok = (bool)(in >> name >> pose(0) >> pose(1) >> pose(2) >> pose(3) >> pose(4) >> pose(5));
+            if (ok)
+                poses[name] = pose;
+        }
+        else if (keyword == "linear" || keyword == "joint")
+        {
+            std::string from, to, duration;
+            ok = (bool)(in >> from >> to >> duration) && poses.count(from) && poses.count(to);
+            if (ok)
+            {
+                Move move;
+                move.name = from + "_to_" + to;
+                move.type = keyword == "linear" ? PlannedSegment::LINEAR : PlannedSegment::JOINT;
+                move.start = poses[from];
+                move.end = poses[to];
+                move.duration = duration == "optimal" ? 0 : atof(duration.c_str());
+                moves.push_back(move);
+            }
+        }
+        else
+            ok = false;
+
+        if (!ok)
+        {
+            std::cerr << fileName << ":" << number << ": cannot parse \"" << line << "\"" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+//joint trajectory of one move, seeded with the configuration the arm has when the move starts
+static void planMove(RobotArm &ra, const Move &move, double Ts, const JointLimits &limits, PlannedSegment &segment)
+{
+    Vector3d pi = move.start.head<3>(), pf = move.end.head<3>();
+    Vector3d PHI_i = move.start.tail<3>(), PHI_f = move.end.tail<3>();
+    double seed[6];
+    std::copy(move.seed, move.seed + 6, seed);
+
+    segment.name = move.name;
+    segment.type = move.type;
+    segment.timing = move.duration > 0 ? PlannedSegment::FIXED : PlannedSegment::OPTIMAL;
+    segment.duration = move.duration;
+    segment.velocityLimits = limits.velocity;
+    segment.accelerationLimits = limits.acceleration;
+    segment.Ts = Ts;
+    segment.start = move.start;
+    segment.end = move.end;
+
+    if (move.type == PlannedSegment::JOINT)
+    {
+        JointPolTraj trajectory = move.duration > 0 ? JointPolTraj(pi, pf, PHI_i, PHI_f, ra, seed, 6, 0, move.duration, Ts)
+                                                    : JointPolTraj(pi, pf, PHI_i, PHI_f, ra, seed, 6, limits, Ts);
+        segment.jointPos = trajectory.getJointPos();
+        segment.jointVel = trajectory.getJointVel();
+        segment.jointAcc = trajectory.getJointAcc();
+        if (segment.timing == PlannedSegment::OPTIMAL)
+            segment.duration = (segment.jointPos.cols() - 1) * Ts;
+        return;
+    }
+
+    CartesianTrajectory trajectory(pi, pf, PHI_i, PHI_f, 0, move.duration > 0 ? move.duration : 1, Ts, CartesianTrajectory::LAZY);
+    if (move.duration <= 0)
+    {
+        std::shared_ptr<const PathTimingLaw> law = std::make_shared<PathTimingLaw>(ra.solvePath(trajectory, 100, seed), limits);
+        trajectory = CartesianTrajectory(pi, pf, PHI_i, PHI_f, law, Ts, CartesianTrajectory::LAZY);
+        segment.duration = law->getDuration();
+    }
+    ra.solveTrajectory(trajectory, seed, segment.jointPos, segment.jointVel, segment.jointAcc);
+}
+
+/**
+ * MAIN
+ */
+int main(int argc, char **argv)
+{
+    if (argc < 4)
+    {
+        std::cerr << "Usage: " << argv[0] << " <task> <robot.urdf> <output> [threads]" << std::endl;
+        return 1;
+    }
+
+    std::ifstream urdf(argv[2]);
+    if (!urdf)
+    {
+        std::cerr << "Cannot open " << argv[2] << std::endl;
+        return 1;
+    }
+    std::stringstream robot_desc;
+    robot_desc << urdf.rdbuf();
+
+    double Ts = 0.1;
+    double seed[6] = {0, -M_PI_2, 0, 0, 0, 0};
+    MoveList moves;
+    if (!readTask(argv[1], Ts, seed, moves))
+        return 1;
+
+    RobotArm ra(robot_desc.str());
+    JointLimits limits = JointLimits::UR5().scaled(JointLimits::DEFAULT_SCALE, JointLimits::DEFAULT_SCALE);
+
+    // Serial pass on the ends of the moves only, so that every move knows the configuration it starts from
+    Clock::time_point start = Clock::now();
+    static const TrajectoryMatrix REST = TrajectoryMatrix::Zero(6, 1);
+    double vel_[6], acc_[6];
+    for (unsigned int k = 0; k < moves.size(); k++)
+    {
+        Move &move = moves[k];
+        std::copy(seed, seed + 6, move.seed);
+
+        if (move.type == PlannedSegment::JOINT)
+        {
+            // Both ends of a joint move are solved from its seed
+            KDL::JntArray q = ra.IKinematics(move.end(0), move.end(1), move.end(2), move.end(3), move.end(4), move.end(5),
+                                             move.seed, REST, 0, REST, 0, vel_, acc_);
+            RobotArm::toSeed(q.data, seed);
+        }
+        else
+        {
+            // A coarse pass along the line stays on the branch the full solve will follow
+            CartesianTrajectory path(move.start.head<3>(), move.end.head<3>(), move.start.tail<3>(), move.end.tail<3>(), 0, 1, Ts, CartesianTrajectory::LAZY);
+            MatrixXd coarse = ra.solvePath(path, 10, move.seed);
+            RobotArm::toSeed(coarse.col(coarse.cols() - 1), seed);
+        }
+    }
+    double serial = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    // Every move on its own thread
+    PlannedSegmentList segments(moves.size());
+    ThreadPool pool(argc > 4 ? atoi(argv[4]) : 0);
+    start = Clock::now();
+    for (unsigned int k = 0; k < moves.size(); k++)
+        pool.submit([&ra, &moves, &segments, &limits, Ts, k]() { planMove(ra, moves[k], Ts, limits, segments[k]); });
+    pool.wait();
+    double parallel = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    TrajectoryFile file;
+    for (unsigned int k = 0; k < segments.size(); k++)
+    {
+        const PlannedSegment &segment = segments[k];
+        std::cout << segment.name << ": " << segment.jointPos.cols() << " samples, " << (segment.jointPos.cols() - 1) * Ts << " s" << std::endl;
+        file.add(segment);
+    }
+
+    if (!file.save(argv[3]))
+    {
+        std::cerr << "Cannot write " << argv[3] << std::endl;
+        return 1;
+    }
+    std::cout << moves.size() << " moves planned in " << serial + parallel << " ms (" << serial << " ms seeding, "
+              << parallel << " ms on " << pool.size() << " threads), written to " << argv[3] << std::endl;
+    return 0;
+}
@@ -0,0 +1,45 @@
+#include "quintic_timing_law.hpp"
+
+// Constructor
+QuinticTimingLaw::QuinticTimingLaw(const Eigen::VectorXd &qi, const Eigen::VectorXd &qf,
+                                   const Eigen::VectorXd &dqi, const Eigen::VectorXd &dqf,
+                                   const Eigen::VectorXd &ddqi, const Eigen::VectorXd &ddqf, double duration)
+    : duration(duration), coeffs(qi.rows(), 6)
+{
+    // Closed form solution of the boundary conditions, instead of inverting the 6x6 system
+    double T = duration, T2 = T * T, T3 = T2 * T;
+    Eigen::ArrayXd h = (qf - qi).array();
+    Eigen::ArrayXd v0 = dqi.array(), v1 = dqf.array();
+    Eigen::ArrayXd acc0 = ddqi.array(), acc1 = ddqf.array();
+
+    coeffs.col(0) = qi.array();
+    coeffs.col(1) = v0;
+    coeffs.col(2) = 0.5 * acc0;
+    coeffs.col(3) = (20 * h - (8 * v1 + 12 * v0) * T - (3 * acc0 - acc1) * T2) / (2 * T3);
+    coeffs.col(4) = (-30 * h + (14 * v1 + 16 * v0) * T + (3 * acc0 - 2 * acc1) * T2) / (2 * T3 * T);
+    coeffs.col(5) = (12 * h - 6 * (v1 + v0) * T + (acc1 - acc0) * T2) / (2 * T3 * T2);
+}
+
+// Constructor
+QuinticTimingLaw::QuinticTimingLaw(double qi, double qf, double dqi, double dqf, double ddqi, double ddqf, double duration)
+    : QuinticTimingLaw(Eigen::VectorXd::Constant(1, qi), Eigen::VectorXd::Constant(1, qf),
+                       Eigen::VectorXd::Constant(1, dqi), Eigen::VectorXd::Constant(1, dqf),
+                       Eigen::VectorXd::Constant(1, ddqi), Eigen::VectorXd::Constant(1, ddqf), duration)
+{
+}
+
+void QuinticTimingLaw::evaluate(double t, int row, double &q, double &qd, double &qdd) const
+{
+    double a0 = coeffs(row, 0), a1 = coeffs(row, 1), a2 = coeffs(row, 2);
+    double a3 = coeffs(row, 3), a4 = coeffs(row, 4), a5 = coeffs(row, 5);
+
+    q = ((((a5 * t + a4) * t + a3) * t + a2) * t + a1) * t + a0;
+    qd = (((5 * a5 * t + 4 * a4) * t + 3 * a3) * t + 2 * a2) * t + a1;
+    qdd = ((20 * a5 * t + 12 * a4) * t + 6 * a3) * t + 2 * a2;
+}
+
+// GETTERS
+
+int QuinticTimingLaw::getRows() const { return coeffs.rows(); }
+double QuinticTimingLaw::getDuration() const { return duration; }
+const Eigen::ArrayXXd &QuinticTimingLaw::getCoefficients() const { return coeffs; }
@@ -0,0 +1,62 @@
+#ifndef QUINTIC_TIMING_LAW
+#define QUINTIC_TIMING_LAW
+
+#include <Eigen/Eigen>
+#include <Eigen/Dense>
+
+//CLASS FOR QUINTIC POLYNOMIAL TIMING LAWS
+//one polynomial per row (e.g. per joint), all sharing the same duration
+class QuinticTimingLaw
+{
+private:
+    double duration;
+    Eigen::ArrayXXd coeffs; // (rows, 6), coefficients a0..a5 of each polynomial
+
+public:
+    // Constructor, boundary positions, velocities and accelerations of every row
+    QuinticTimingLaw(const Eigen::VectorXd &qi, const Eigen::VectorXd &qf,
+                     const Eigen::VectorXd &dqi, const Eigen::VectorXd &dqf,
+                     const Eigen::VectorXd &ddqi, const Eigen::VectorXd &ddqf, double duration);
+
+    // Constructor, single polynomial
+    QuinticTimingLaw(double qi, double qf, double dqi, double dqf, double ddqi, double ddqf, double duration);
+
+    // Position, velocity and acceleration of every row at the times 0, Ts, 2Ts, ... (measured from the start),
+    // outputs are resized to (rows, samples)
+    template <typename Derived>
+    void evaluate(int samples, double Ts, Eigen::PlainObjectBase<Derived> &q, Eigen::PlainObjectBase<Derived> &qd, Eigen::PlainObjectBase<Derived> &qdd) const;
+
+    // Position, velocity and acceleration of one row at time t
+    void evaluate(double t, int row, double &q, double &qd, double &qdd) const;
+
+    // Getters
+    int getRows() const;
+    double getDuration() const;
+    const Eigen::ArrayXXd &getCoefficients() const;
+};
+
+template <typename Derived>
+void QuinticTimingLaw::evaluate(int samples, double Ts, Eigen::PlainObjectBase<Derived> &q, Eigen::PlainObjectBase<Derived> &qd, Eigen::PlainObjectBase<Derived> &qdd) const
+{
+    int rows = coeffs.rows();
+    q.resize(rows, samples);
+    qd.resize(rows, samples);
+    qdd.resize(rows, samples);
+
+    // Sample times as a lazy expression, no buffer is allocated for them
+    const Eigen::Array<double, 1, Eigen::Dynamic>::RandomAccessLinSpacedReturnType t =
+        Eigen::Array<double, 1, Eigen::Dynamic>::LinSpaced(samples, 0, (samples - 1) * Ts);
+
+    // Horner's scheme, each row is a single fused expression vectorized over all the samples
+    for (int j = 0; j < rows; j++)
+    {
+        double a0 = coeffs(j, 0), a1 = coeffs(j, 1), a2 = coeffs(j, 2);
+        double a3 = coeffs(j, 3), a4 = coeffs(j, 4), a5 = coeffs(j, 5);
+
+        q.row(j) = (((((a5 * t + a4) * t + a3) * t + a2) * t + a1) * t + a0).matrix();
+        qd.row(j) = ((((5 * a5 * t + 4 * a4) * t + 3 * a3) * t + 2 * a2) * t + a1).matrix();
+        qdd.row(j) = (((20 * a5 * t + 12 * a4) * t + 6 * a3) * t + 2 * a2).matrix();
+    }
+}
+
+#endif
@@ -0,0 +1,219 @@
+#include "seed_map.hpp"
+
+#define _USE_MATH_DEFINES // For PI costants
+#include <cmath>
+#include <algorithm>
+#include <fstream>
+#include <limits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char MAGIC[4] = {'R', 'V', 'C', 'S'};
+static const uint32_t VERSION = 1;
+
+struct SeedMap::Header
+{
+    char magic[4];
+    uint32_t version;
+    Grid grid;
+};
+
+static uint64_t hashValues(const double *values, int n, uint64_t h)
+{
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(values);
+    for (size_t i = 0; i < n * sizeof(double); i++)
+    {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+SeedMap::Grid::Grid() : cellSize(0.05), tiltBins(4), headingBins(8), tag(0)
+{
+    std::fill(origin, origin + 3, 0.0);
+    std::fill(dims, dims + 3, 0);
+}
+
+size_t SeedMap::Grid::cells() const
+{
+    return (size_t)dims[0] * dims[1] * dims[2];
+}
+
+int SeedMap::Grid::buckets() const
+{
+    return tiltBins * headingBins;
+}
+
+long SeedMap::Grid::cellOf(const Eigen::Vector3d &position) const
+{
+    long index = 0;
+    for (int i = 2; i >= 0; i--)
+    {
+        double c = std::floor((position(i) - origin[i]) / cellSize);
+        if (!(c >= 0 && c < dims[i]))
+            return -1;
+        index = index * dims[i] + (long)c;
+    }
+    return index;
+}
+
+Eigen::Vector3d SeedMap::Grid::cellCenter(long cell) const
+{
+    Eigen::Vector3d center;
+    for (int i = 0; i < 3; i++)
+    {
+        center(i) = origin[i] + (cell % dims[i] + 0.5) * cellSize;
+        cell /= dims[i];
+    }
+    return center;
+}
+
+int SeedMap::Grid::bucketOf(const Eigen::Matrix3d &rotation) const
+{
+    double tilt = std::acos(std::min(1.0, std::max(-1.0, -rotation(2, 2))));
+    double heading = std::atan2(rotation(1, 0), rotation(0, 0));
+    int t = std::min((int)(tilt / M_PI * tiltBins), (int)tiltBins - 1);
+    int h = std::min((int)((heading + M_PI) / (2 * M_PI) * headingBins), (int)headingBins - 1);
+    return t * headingBins + h;
+}
+
+// Constructor
+SeedMap::SeedMap() : fd(-1), map(NULL), mapSize(0), seeds(NULL), filled(0)
+{
+}
+
+SeedMap::~SeedMap()
+{
+    close();
+}
+
+uint64_t SeedMap::modelTag(const UR5Kinematics &model)
+{
+    const double dh[6] = {model.getD1(), model.getA2(), model.getA3(), model.getD4(), model.getD5(), model.getD6()};
+    uint64_t h = hashValues(dh, 6, 14695981039346656037ULL);
+    h = hashValues(model.getBase().matrix().data(), 16, h);
+    return hashValues(model.getTool().matrix().data(), 16, h);
+}
+
+bool SeedMap::save(const std::string &fileName, const Grid &grid, const std::vector<float> &seeds)
+{
+    if (seeds.size() != grid.cells() * grid.buckets() * 6)
+        return false;
+
+    Header header;
+    std::copy(MAGIC, MAGIC + 4, header.magic);
+    header.version = VERSION;
+    header.grid = grid;
+
+    std::ofstream out(fileName.c_str(), std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(seeds.data()), seeds.size() * sizeof(float));
+    return (bool)out.flush();
+}
+
+bool SeedMap::open(const std::string &fileName)
+{
+    close();
+    fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Header))
+    {
+        close();
+        return false;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        map = NULL;
+        close();
+        return false;
+    }
+    mapSize = st.st_size;
+    const Header *header = static_cast<const Header *>(map);
+    grid = header->grid;
+    if (!std::equal(header->magic, header->magic + 4, MAGIC) || header->version != VERSION || !(grid.cellSize > 0) ||
+        grid.buckets() == 0 || mapSize != sizeof(Header) + grid.cells() * grid.buckets() * 6 * sizeof(float))
+    {
+        close();
+        return false;
+    }
+    seeds = reinterpret_cast<const float *>(header + 1);
+
+    filled = 0;
+    for (size_t k = 0; k < grid.cells() * grid.buckets(); k++)
+        filled += !std::isnan(seeds[k * 6]);
+    return true;
+}
+
+void SeedMap::close()
+{
+    if (map != NULL)
+        munmap(map, mapSize);
+    if (fd >= 0)
+        ::close(fd);
+    fd = -1;
+    map = NULL;
+    mapSize = 0;
+    grid = Grid();
+    seeds = NULL;
+    filled = 0;
+}
+
+bool SeedMap::isOpen() const
+{
+    return map != NULL;
+}
+
+bool SeedMap::lookup(const Eigen::Vector3d &position, const Eigen::Matrix3d &rotation, double q[6]) const
+{
+    if (map == NULL)
+        return false;
+
+    int bucket = grid.bucketOf(rotation);
+    long cell[3];
+    for (int i = 0; i < 3; i++)
+        cell[i] = (long)std::floor((position(i) - grid.origin[i]) / grid.cellSize);
+
+    // Shells of growing distance around the cell, the first one with a seed gives the nearest
+    for (long r = 0; r <= SEARCH_RADIUS; r++)
+    {
+        const float *best = NULL;
+        double bestDistance = std::numeric_limits<double>::infinity();
+        for (long z = cell[2] - r; z <= cell[2] + r; z++)
+            for (long y = cell[1] - r; y <= cell[1] + r; y++)
+                for (long x = cell[0] - r; x <= cell[0] + r; x++)
+                {
+                    if (std::max(std::max(std::labs(x - cell[0]), std::labs(y - cell[1])), std::labs(z - cell[2])) != r ||
+                        x < 0 || y < 0 || z < 0 || x >= grid.dims[0] || y >= grid.dims[1] || z >= grid.dims[2])
+                        continue;
+                    long index = (z * grid.dims[1] + y) * grid.dims[0] + x;
+                    const float *seed = seeds + (index * grid.buckets() + bucket) * 6;
+                    if (std::isnan(seed[0]))
+                        continue;
+                    double distance = (grid.cellCenter(index) - position).squaredNorm();
+                    if (distance < bestDistance)
+                    {
+                        bestDistance = distance;
+                        best = seed;
+                    }
+                }
+        if (best != NULL)
+        {
+            std::copy(best, best + 6, q);
+            return true;
+        }
+    }
+    return false;
+}
+
+// GETTERS
+
+const SeedMap::Grid &SeedMap::getGrid() const { return grid; }
+size_t SeedMap::getFilled() const { return filled; }
@@ -0,0 +1,80 @@
+#ifndef SEED_MAP
+#define SEED_MAP
+
+#include <Eigen/Eigen>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ur5_kinematics.hpp"
+
+//CLASS FOR A VOXEL GRID OF IK SEEDS OVER THE WORKSPACE, MEMORY MAPPED FROM A FILE BUILT OFFLINE BY rvc_seed_map
+//every cell holds one joint configuration (chain order) per orientation bucket, whose tool pose falls in the
+//cell with an orientation in the bucket. Buckets split the tilt of the tool z axis from the downward vertical
+//and the heading of the tool x axis in the horizontal plane.
+//The map is read only once opened, so any thread can look up seeds without locking
+class SeedMap
+{
+public:
+    struct Grid
+    {
+        Grid();
+
+        double origin[3]; // [m] corner of the first cell, in the chain base frame
+        double cellSize;  // [m]
+        uint32_t dims[3];
+        uint32_t tiltBins;
+        uint32_t headingBins;
+        uint64_t tag; // model the seeds were built for, see modelTag
+
+        size_t cells() const;
+        int buckets() const;
+        // Index of the cell holding the position, -1 outside the grid
+        long cellOf(const Eigen::Vector3d &position) const;
+        Eigen::Vector3d cellCenter(long cell) const;
+        int bucketOf(const Eigen::Matrix3d &rotation) const;
+    };
+
+    enum
+    {
+        SEARCH_RADIUS = 2 // [cells] empty cells borrow the seed of the nearest filled one within this distance
+    };
+
+private:
+    struct Header;
+
+    int fd;
+    void *map;
+    size_t mapSize;
+    Grid grid;
+    const float *seeds; // cells x buckets x 6, empty entries have NaN as first joint
+    size_t filled;
+
+public:
+    SeedMap();
+    ~SeedMap();
+    SeedMap(const SeedMap &) = delete;
+    SeedMap &operator=(const SeedMap &) = delete;
+
+    // Hash of the geometry and mounting frames of the model
+    static uint64_t modelTag(const UR5Kinematics &model);
+
+    // Writes a map, seeds laid out as the mapped ones
+    static bool save(const std::string &fileName, const Grid &grid, const std::vector<float> &seeds);
+
+    bool open(const std::string &fileName);
+    void close();
+    bool isOpen() const;
+
+    // Seed of the cell of the position, or of the nearest filled cell within SEARCH_RADIUS, in the bucket of
+    // the rotation; false when there is none
+    bool lookup(const Eigen::Vector3d &position, const Eigen::Matrix3d &rotation, double q[6]) const;
+
+    // Getters
+    const Grid &getGrid() const;
+    size_t getFilled() const;
+};
+
+#endif
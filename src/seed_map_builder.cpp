@@ -0,0 +1,154 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cstdlib>
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+#define _USE_MATH_DEFINES // For PI costants
+#include <cmath>
+#include <Eigen/Eigen>
+
+#include "kdl_kinematics.hpp"
+#include "seed_map.hpp"
+#include "ur5_batch_fk.hpp"
+
+using namespace Eigen;
+
+typedef std::chrono::steady_clock Clock;
+
+// Configurations evaluated per batched FK call
+static const int BATCH = 1 << 16;
+
+// Among the configurations of a cell and bucket the one nearest to the cell center wins, with a small
+// preference for the vertical configuration so that neighbouring seeds stay on the same branch
+static const double POSTURE_WEIGHT = 0.01; // [cells / rad^2]
+static const double REFERENCE[6] = {0, -M_PI_2, 0, 0, 0, 0};
+
+// Random configurations in chain order, every joint in [-pi, pi]
+static void randomBatch(std::mt19937_64 &random, UR5BatchFK::JointBatch &q)
+{
+    std::uniform_real_distribution<double> angle(-M_PI, M_PI);
+    for (int j = 0; j < 6; j++)
+        for (int i = 0; i < q.rows(); i++)
+            q(i, j) = angle(random);
+}
+
+/**
+ * MAIN
+ */
+int main(int argc, char **argv)
+{
+    if (argc < 3 || (argc > 5 && argc != 11))
+    {
+        std::cerr << "Usage: " << argv[0] << " <robot.urdf> <output> [cell size] [samples] [xmin ymin zmin xmax ymax zmax]" << std::endl;
+        return 1;
+    }
+
+    std::ifstream urdf(argv[1]);
+    if (!urdf)
+    {
+        std::cerr << "Cannot open " << argv[1] << std::endl;
+        return 1;
+    }
+    std::stringstream robot_desc;
+    robot_desc << urdf.rdbuf();
+
+    RobotArm ra(robot_desc.str());
+    const UR5Kinematics *model = ra.getAnalyticModel();
+    if (model == NULL)
+    {
+        std::cerr << "The chain does not match the UR5 geometry, no seed map can be built" << std::endl;
+        return 1;
+    }
+    UR5BatchFK fk(*model);
+
+    SeedMap::Grid grid;
+    grid.tag = SeedMap::modelTag(*model);
+    if (argc > 3)
+        grid.cellSize = atof(argv[3]);
+    long samples = argc > 4 ? atol(argv[4]) : 20000000;
+
+    UR5BatchFK::JointBatch q(BATCH, 6);
+    UR5BatchFK::PositionBatch positions;
+    UR5BatchFK::RotationBatch rotations;
+    std::mt19937_64 random(1);
+
+    // Workspace bounds, given or those of a first sweep
+    Vector3d lower, upper;
+    if (argc == 11)
+    {
+        lower << atof(argv[5]), atof(argv[6]), atof(argv[7]);
+        upper << atof(argv[8]), atof(argv[9]), atof(argv[10]);
+    }
+    else
+    {
+        lower.setConstant(std::numeric_limits<double>::infinity());
+        upper = -lower;
+        for (int b = 0; b < 16; b++)
+        {
+            randomBatch(random, q);
+            fk.forward(q, positions, rotations);
+            lower = lower.cwiseMin(positions.colwise().minCoeff().transpose());
+            upper = upper.cwiseMax(positions.colwise().maxCoeff().transpose());
+        }
+    }
+    for (int i = 0; i < 3; i++)
+    {
+        grid.origin[i] = lower(i);
+        grid.dims[i] = std::max(1, (int)std::ceil((upper(i) - lower(i)) / grid.cellSize));
+    }
+
+    size_t entries = grid.cells() * grid.buckets();
+    std::vector<float> seeds(entries * 6, std::numeric_limits<float>::quiet_NaN());
+    std::vector<float> scores(entries, std::numeric_limits<float>::infinity());
+
+    Clock::time_point start = Clock::now();
+    for (long done = 0; done < samples; done += BATCH)
+    {
+        randomBatch(random, q);
+        fk.forward(q, positions, rotations);
+        for (int i = 0; i < BATCH; i++)
+        {
+            Vector3d p = positions.row(i).transpose();
+            long cell = grid.cellOf(p);
+            if (cell < 0)
+                continue;
+
+            Matrix3d R;
+            R << rotations(i, 0), rotations(i, 1), rotations(i, 2), rotations(i, 3), rotations(i, 4), rotations(i, 5),
+                rotations(i, 6), rotations(i, 7), rotations(i, 8);
+            size_t entry = cell * grid.buckets() + grid.bucketOf(R);
+
+            double posture = 0;
+            for (int j = 0; j < 6; j++)
+                posture += (q(i, j) - REFERENCE[j]) * (q(i, j) - REFERENCE[j]);
+            float score = (grid.cellCenter(cell) - p).norm() / grid.cellSize + POSTURE_WEIGHT * posture;
+            if (score < scores[entry])
+            {
+                scores[entry] = score;
+                for (int j = 0; j < 6; j++)
+                    seeds[entry * 6 + j] = q(i, j);
+            }
+        }
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    size_t filled = 0;
+    for (size_t k = 0; k < entries; k++)
+        filled += !std::isnan(seeds[k * 6]);
+
+    if (!SeedMap::save(argv[2], grid, seeds))
+    {
+        std::cerr << "Cannot write " << argv[2] << std::endl;
+        return 1;
+    }
+    std::cout << grid.dims[0] << " x " << grid.dims[1] << " x " << grid.dims[2] << " cells of " << grid.cellSize << " m from ("
+              << lower.transpose() << "), " << grid.buckets() << " orientation buckets" << std::endl;
+    std::cout << samples << " configurations in " << elapsed << " s, " << filled << " of " << entries << " seeds filled, written to "
+              << argv[2] << std::endl;
+    return 0;
+}
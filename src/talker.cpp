@@ -1,8 +1,12 @@
 #include <iostream>
+#include <fstream>
 #include <sstream>
 #define _USE_MATH_DEFINES // For PI costants
 #include <cmath>
 #include <complex>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
 #include <Eigen/Eigen>
 #include <Eigen/Dense>
 #include <Eigen/Geometry>
@@ -21,13 +25,17 @@
 #include <tf2_ros/transform_broadcaster.h>
 #include <control_msgs/FollowJointTrajectoryAction.h>
 
-#include <cv_bridge/cv_bridge.h>
-#include <opencv2/highgui.hpp>
 #include <opencv2/aruco.hpp>
 
 #include "kdl_kinematics.hpp"
 #include "cartesian_trajectory.hpp"
 #include "joint_pol_traj.hpp"
+#include "aruco_detector.hpp"
+#include "marker_pose_cache.hpp"
+#include "trajectory_file.hpp"
+#include "trajectory_cache.hpp"
+#include "metrics.hpp"
+#include "goal_builder.hpp"
 
 #include <ros/ros.h>
 #include <actionlib/client/simple_action_client.h>
@@ -40,20 +48,73 @@
 using namespace Eigen;
 
 //variable to check if we read the actual joint position
-bool joints_done = false;
+std::atomic<bool> joints_done(false);
 
-// Message data
-cv_bridge::CvImagePtr imagePtr;
-cv::Mat K(3, 3, CV_64F);
-cv::Mat D(1, 5, CV_64F);
-
-//contains the actual joint position
+//contains the actual joint position, written by the spinner thread, read through getJoints
 double joints[6];
+std::mutex jointsMutex;
+
+//seconds a marker pose may be old to be used, and seconds to wait for one
+double markerMaxAge = 0.5;
+double markerTimeout = 10.0;
+
+//solve the IK of operational space trajectories in parallel segments
+bool parallelIK = false;
+
+//solve the IK of operational space trajectories within the IK budget of the arm, checking every sample
+bool checkedIK = false;
+
+//seconds of operational space trajectory planned ahead while the arm moves, zero plans the whole move first
+double streamChunk = 0;
+
+//time for a streamed goal to reach the controller
+const double STREAM_MARGIN = 0.05;
+
+//time every move as fast as the joint limits allow instead of in the given time
+bool timeOptimal = false;
+JointLimits jointLimits = JointLimits::UR5();
+
+//path samples solved for the time optimal law of an operational space move
+int optimalPathPoints = 100;
+
+//go through home without stopping, passing at most blendDeviation [m] from it
+bool blendMoves = false;
+double blendDeviation = 0.05;
+
+//send joint velocities and accelerations with the positions, as feedforward for the controller
+bool sendDerivatives = true;
+
+//orientation of the operational space moves, RPY angles interpolated linearly or SLERP
+CartesianTrajectory::OrientationPath orientationPath = CartesianTrajectory::RPY_LINEAR;
+
+//moves planned offline by rvc_planner, used instead of planning when the inputs match
+TrajectoryFile taskFile;
+double taskTolerance = 1e-3;      // [m], [rad] on the start and end poses
+double taskJointTolerance = 0.05; // [rad] between the actual joints and the first sample
+
+//moves solved in the previous cycles and runs, looked up before planning
+TrajectoryCache trajectoryCache;
+
+//every goal sent to the arm is built here, in message storage reused from one move to the next
+GoalBuilder goalBuilder({"robot_arm_shoulder_pan_joint",
+                         "robot_arm_shoulder_lift_joint",
+                         "robot_arm_elbow_joint",
+                         "robot_arm_wrist_1_joint",
+                         "robot_arm_wrist_2_joint",
+                         "robot_arm_wrist_3_joint"});
+
+//periodic export of the metrics, to a CSV file and/or a topic
+std::ofstream metricsCsv;
+bool metricsTopic = false;
 
 // Topics
-ros::Publisher dataPub;
+ros::Publisher dataPub, metricsPub;
 ros::Subscriber imageSub, cameraSub, joint_state_sub;
 tf2_ros::Buffer tfBuffer;
+boost::shared_ptr<tf2_ros::TransformBroadcaster> tfBroadcaster;
+
+//last pose of every detected aruco
+MarkerPoseCache markerCache;
 
 //action client variable for connecting to trajectory action server
 typedef actionlib::SimpleActionClient<control_msgs::FollowJointTrajectoryAction> arm_control_client;
@@ -79,18 +140,10 @@ void createArmClient(arm_control_client_Ptr& actionClient)
     throw std::runtime_error("Error in createArmClient: arm controller action server not available");
 }
 
-//callback get intrinsic parameters of the camera
-void cameraCallback(const sensor_msgs::CameraInfoConstPtr &msg)
-{
-    // Retrive camera matrix
-    for (int i = 0; i < 3; i++)
-        for (int j = 0; j < 3; j++)
-            K.at<double>(i, j) = msg->K[i * 3 + j];
-}
-
 //callback on joint state to keep saved the actual position of the joints
 void jointsCallback(const sensor_msgs::JointState &msg)
 {
+    std::lock_guard<std::mutex> lock(jointsMutex);
     for (int i = 0; i < 6; i++)
     {
         joints[i] = msg.position[i];
@@ -98,12 +151,20 @@ void jointsCallback(const sensor_msgs::JointState &msg)
     joints_done = true;
 }
 
-//method to create frames of each aruco(id,rvec,tvec) and publish it in "tf"
-void addToTf(int id, cv::Vec3d rvec, cv::Vec3d tvec)
+//consistent snapshot of the actual joint position
+void getJoints(double q[6])
+{
+    std::lock_guard<std::mutex> lock(jointsMutex);
+    std::copy(joints, joints + 6, q);
+}
+
+//method to create the frame of an aruco(id,rvec,tvec), add it to the batch published in "tf" and store it in the cache
+void addToTf(std::vector<geometry_msgs::TransformStamped> &batch, int id, const cv::Vec3d &rvec, const cv::Vec3d &tvec,
+             const ros::Time &stamp, const Eigen::Isometry3d *baseToCamera)
 {
     //attach the frame on last camera frame
-    tf2_ros::TransformBroadcaster tfb;
-    geometry_msgs::TransformStamped transformStamped;
+    batch.push_back(geometry_msgs::TransformStamped());
+    geometry_msgs::TransformStamped &transformStamped = batch.back();
     transformStamped.header.frame_id = "robot_wrist_rgbd_color_optical_frame";
     transformStamped.child_frame_id = "aruco_" + std::to_string(id);
     //ROS_INFO("created frame: " +  transformStamped.child_frame_id);
@@ -117,249 +178,404 @@ void addToTf(int id, cv::Vec3d rvec, cv::Vec3d tvec)
     transformStamped.transform.rotation.y = q.y();
     transformStamped.transform.rotation.z = q.z();
     transformStamped.transform.rotation.w = q.w();
-    transformStamped.header.stamp = ros::Time::now();
-    tfb.sendTransform(transformStamped);
-    ros::spinOnce();
+    transformStamped.header.stamp = stamp;
+
+    //same pose in the cache, and in the base frame when the camera pose is known
+    MarkerPose pose;
+    pose.stamp = stamp;
+    pose.cameraPose = Eigen::Translation3d(-tvec[0], tvec[1], tvec[2]) * Eigen::Quaterniond(q.w(), q.x(), q.y(), q.z());
+    pose.hasBasePose = baseToCamera != nullptr;
+    if (pose.hasBasePose)
+        pose.basePose = *baseToCamera * pose.cameraPose;
+    markerCache.update(id, pose);
 }
 
-//callback for each read image from camera
-void imageCallback(const sensor_msgs::ImageConstPtr &msg)
+//called by the detector worker with the markers found in each frame, all of them go to tf in one message
+void markersCallback(const ros::Time &frameStamp, const std::vector<MarkerDetection> &markers, const Eigen::Isometry3d *baseToCamera)
 {
-    cv::Mat image, imageCopy;
-    try
+    //only the detector worker calls this, so the batch can be reused across frames
+    static std::vector<geometry_msgs::TransformStamped> batch;
+    batch.clear();
+
+    ros::Time stamp = frameStamp.isZero() ? ros::Time::now() : frameStamp;
+    for (unsigned int i = 0; i < markers.size(); i++)
     {
-        // Retrive image from camera topic
-        imagePtr = cv_bridge::toCvCopy(msg, sensor_msgs::image_encodings::BGR8);
+        // Save aruco id, rotation and traslation
+        addToTf(batch, markers[i].id, markers[i].rvec, markers[i].tvec, stamp, baseToCamera);
     }
-    catch (cv_bridge::Exception &e)
+    tfBroadcaster->sendTransform(batch);
+}
+
+//append the samples [begin, end) of the joint trajectory to the goal being built, on the time base of sample 0
+//shifted by offset seconds; velocities and accelerations are filled in when both are given.
+//Samples with joints outside the UR5 joint range are left out, and then the move must not be sent: false
+bool addTrajectoryPoints(const TrajectoryMatrix &target_joints, int begin, int end, double Ts, double offset = 0,
+                         const TrajectoryMatrix *target_vel = NULL, const TrajectoryMatrix *target_acc = NULL)
+{
+    int dropped = goalBuilder.append(target_joints, begin, end, Ts, offset, target_vel, target_acc, UR5Kinematics::JOINT_RANGE);
+    if (dropped > 0)
+        ROS_ERROR("%d of %d trajectory points with joints outside +-%.2f rad, move aborted", dropped, end - begin, UR5Kinematics::JOINT_RANGE);
+    return dropped == 0;
+}
+
+//write a snapshot of the metrics to the enabled outputs
+void exportMetrics(const ros::WallTimerEvent &event)
+{
+    double time = event.current_real.toSec();
+    if (metricsCsv.is_open())
     {
-        ROS_ERROR("cv_bridge exception: %s", e.what());
-        return;
+        Metrics::writeCsv(metricsCsv, time);
+        metricsCsv.flush();
     }
-    image = imagePtr->image;
-    cv::flip(image, image, 1);
-    image.copyTo(imageCopy);
-
-    // Aruco detection
-    std::vector<int> ids;
-    std::vector<std::vector<cv::Point2f>> corners, rejCandidates;
-    cv::Ptr<cv::aruco::DetectorParameters> parameters = cv::aruco::DetectorParameters::create();
-    cv::Ptr<cv::aruco::Dictionary> dictionary =
-        cv::aruco::getPredefinedDictionary(cv::aruco::DICT_6X6_250);
-    cv::aruco::detectMarkers(image, dictionary, corners, ids, parameters, rejCandidates);
-
-    // No aruco detected
-    if (ids.size() <= 0)
-        return;
+    if (metricsTopic)
+    {
+        std::ostringstream out;
+        Metrics::writeCsv(out, time);
+        std_msgs::String msg;
+        msg.data = out.str();
+        metricsPub.publish(msg);
+    }
+}
+
+//send the goal and wait for the arm to execute it, the time since planningStart is the planning time of the goal
+void executeGoal(const control_msgs::FollowJointTrajectoryGoal &goal, Metrics::Clock::time_point planningStart)
+{
+    Metrics::Clock::time_point sent = Metrics::Clock::now();
+    Metrics::record(Metrics::PLANNING_TIME, std::chrono::duration<double, std::micro>(sent - planningStart).count());
+    Metrics::count(Metrics::GOALS_SENT);
 
-    // At least one marker has been detected
-    //ROS_INFO("Cubes detected!");
-    cv::aruco::drawDetectedMarkers(imageCopy, corners, ids);
+    Metrics::ScopedTimer timer(Metrics::GOAL_EXECUTION_TIME);
+    ArmClient->sendGoalAndWait(goal);
+}
 
-    // Aruco information container
-    std::vector<cv::Vec3d> rvecs, tvecs;
-    cv::aruco::estimatePoseSingleMarkers(corners, 0.03, K, D, rvecs, tvecs);
-    // draw axis for each marker
-    for (int i = 0; i < ids.size(); i++)
+//log the quality of a checked IK solve, false when samples were rejected and the move must not be sent
+bool checkIKReport(const RobotArm::IKReport &report)
+{
+    ROS_INFO("IK of %d samples: %d LMA iterations (worst sample %d), %d retried, residual %.2e, slowest sample %.2f ms",
+             report.samples, report.iterations, report.maxIterations, report.retried, report.maxResidual, report.maxTime * 1e3);
+    if (report.rejected.empty())
+        return true;
+    ROS_ERROR("IK rejected %u samples, the first is %d, move aborted", (unsigned int)report.rejected.size(), report.rejected.front());
+    return false;
+}
+
+//plan the trajectory in chunks and start moving as soon as the first one is ready,
+//every goal carries the points not executed yet on the time base of the first goal,
+//so the controller replaces the running trajectory without stopping the arm; the joint positions are left in target_joints,
+//and their velocities and accelerations in vel and acc when both are given.
+//The planning time is the one of the first chunk, execution is timed from the first goal.
+//A chunk out of the joint range, or with samples rejected by checked IK, stops the arm and aborts the move: false
+bool streamTrajectory(const CartesianTrajectory &trajectory, double Ts, RobotArm &ra, TrajectoryMatrix &target_joints, TrajectoryMatrix *vel,
+                      TrajectoryMatrix *acc, Metrics::Clock::time_point planningStart)
+{
+    int length = trajectory.get_length();
+    int chunk = std::max(1, (int)ceil(streamChunk / Ts));
+    target_joints.resize(6, length);
+    if (vel != NULL && acc != NULL)
     {
-        // Save aruco id, rotation and traslation
-        addToTf(ids[i], rvecs[i], tvecs[i]);
-        cv::aruco::drawAxis(imageCopy, K, D, rvecs[i], tvecs[i], 0.1);
+        vel->resize(6, length);
+        acc->resize(6, length);
     }
+    double q[6];
+    getJoints(q);
+
+    RobotArm::IKReport report;
+    ros::Time start;
+    Metrics::Clock::time_point executionStart;
+    for (int begin = 0; begin < length; begin += chunk)
+    {
+        int end = std::min(begin + chunk, length);
+        if (checkedIK)
+            ra.solveTrajectory(trajectory, begin, end, q, target_joints, report, vel, acc);
+        else
+            ra.solveTrajectory(trajectory, begin, end, q, target_joints, vel, acc);
+        if (checkedIK && !report.rejected.empty())
+        {
+            checkIKReport(report);
+            if (begin > 0)
+                ArmClient->cancelGoal();
+            return false;
+        }
 
-    //Uncomment the following lines to show arucos on separate window
-    //cv::imshow("out", imageCopy);
+        int first = 0;
+        if (begin == 0)
+        {
+            start = ros::Time::now();
+            Metrics::record(Metrics::PLANNING_TIME, std::chrono::duration<double, std::micro>(Metrics::Clock::now() - planningStart).count());
+        }
+        else
+        {
+            //leave out the points the arm has already passed, and the ones it will pass before the goal arrives
+            double elapsed = (ros::Time::now() - start).toSec();
+            first = std::min(begin, (int)ceil((elapsed + STREAM_MARGIN) / Ts));
+            if (elapsed > begin * Ts)
+                ROS_WARN("Trajectory chunk %d planned %.3f s after its start, the arm waited for it", begin / chunk, elapsed - begin * Ts);
+        }
 
-    //char key = (char) cv::waitKey(1);
+        goalBuilder.clear();
+        goalBuilder.setStamp(start);
+        if (!addTrajectoryPoints(target_joints, first, end, Ts, 0, vel, acc))
+        {
+            if (begin > 0)
+                ArmClient->cancelGoal();
+            return false;
+        }
+        Metrics::count(Metrics::GOALS_SENT);
+        ArmClient->sendGoal(goalBuilder.getGoal());
+        if (begin == 0)
+            executionStart = Metrics::Clock::now();
+    }
+
+    ArmClient->waitForResult();
+    Metrics::record(Metrics::GOAL_EXECUTION_TIME, std::chrono::duration<double, std::micro>(Metrics::Clock::now() - executionStart).count());
+    if (checkedIK)
+        checkIKReport(report);
+    return true;
 }
 
-//transform the aruco position to robot base frame
-geometry_msgs::TransformStamped getArucoTransformStamped(int id)
+//offline planned move between the two poses, if it was planned with the same timing (time optimal under the same
+//limits, or lasting tf - ti) and the same Ts, and starts where the arm is
+const PlannedSegment *findPlannedMove(PlannedSegment::Type type, const Vector3d &pi, const Vector3d &pf, const Vector3d &PHI_i, const Vector3d &PHI_f,
+                                      double ti, double tf, double Ts, const double q[6])
 {
-    geometry_msgs::TransformStamped transformStamped;
-    try
+    Vector6d start, end;
+    start << pi, PHI_i;
+    end << pf, PHI_f;
+    PlannedSegment::Timing timing = timeOptimal ? PlannedSegment::OPTIMAL : PlannedSegment::FIXED;
+    const PlannedSegment *segment = taskFile.find(type, start, end, taskTolerance, timing, tf - ti, jointLimits);
+    if (segment == NULL || std::abs(segment->Ts - Ts) > 1e-9 || segment->jointPos.cols() == 0)
+        return NULL;
+
+    //seeds are in joint_states order, the segment in chain order
+    Vector6d actual;
+    actual << q[2], q[1], q[0], q[3], q[4], q[5];
+    if ((segment->jointPos.col(0) - actual).cwiseAbs().maxCoeff() > taskJointTolerance)
     {
-        transformStamped = tfBuffer.lookupTransform("robot_base_footprint", "aruco_" + std::to_string(id), ros::Time(0));
+        ROS_WARN("Planned move %s starts from another configuration, planning it again", segment->name.c_str());
+        return NULL;
     }
-    catch (tf::TransformException &ex)
-    {
+    return segment;
+}
+
+//key of a move in the trajectory cache, the settings that change the trajectory are part of the kind
+TrajectoryCache::Key cacheKey(const std::string &planner, const Vector3d &pi, const Vector3d &pf, const Vector3d &PHI_i, const Vector3d &PHI_f,
+                              double ti, double tf, double Ts, const double q[6])
+{
+    uint64_t kind = TrajectoryCache::hash(planner.data(), planner.size());
+    kind = TrajectoryCache::hash(&timeOptimal, sizeof(timeOptimal), kind);
+    kind = TrajectoryCache::hash(&optimalPathPoints, sizeof(optimalPathPoints), kind);
+    kind = TrajectoryCache::hash(&orientationPath, sizeof(orientationPath), kind);
+    return TrajectoryCache::makeKey(kind, pi, pf, PHI_i, PHI_f, ti, tf, Ts, q);
+}
 
-        ros::Duration(1.0).sleep();
-        ROS_ERROR("%s", ex.what());
+//joint trajectory of an operational space move in target_joints, with velocities and accelerations when vel and acc are given;
+//false when checked IK rejected samples, the move must not be sent
+bool solveMove(const CartesianTrajectory &trajectory, double q[6], RobotArm &ra, TrajectoryMatrix &target_joints, TrajectoryMatrix *vel,
+               TrajectoryMatrix *acc)
+{
+    if (checkedIK)
+    {
+        RobotArm::IKReport report;
+        target_joints = ra.solveTrajectory(trajectory, q, report, vel, acc);
+        if (!checkIKReport(report))
+            return false;
     }
-    return transformStamped;
+    else if (parallelIK)
+        target_joints = ra.solveTrajectoryParallel(trajectory, q, 0, vel, acc);
+    else if (vel != NULL && acc != NULL)
+        ra.solveTrajectory(trajectory, q, target_joints, *vel, *acc);
+    else
+        target_joints = ra.solveTrajectory(trajectory, q);
+    return true;
 }
 
 //trajectory in operational space
-void sendTrajectory(MatrixXd pi, MatrixXd pf, MatrixXd PHI_i, MatrixXd PHI_f, double ti, double tf, double Ts, RobotArm ra)
+void sendTrajectory(const Vector3d &pi, const Vector3d &pf, const Vector3d &PHI_i, const Vector3d &PHI_f, double ti, double tf, double Ts, RobotArm &ra)
 {
     std::cout << "Initializing operational space trajectory..." << std::endl;
-    CartesianTrajectory *trajectory;
+    Metrics::Clock::time_point planningStart = Metrics::Clock::now();
+    double q[6];
+    getJoints(q);
+
+    goalBuilder.clear();
+
+    //rvc_planner interpolates RPY angles
+    const PlannedSegment *planned = NULL;
+    if (orientationPath == CartesianTrajectory::RPY_LINEAR)
+        planned = findPlannedMove(PlannedSegment::LINEAR, pi, pf, PHI_i, PHI_f, ti, tf, Ts, q);
+    if (planned != NULL)
+    {
+        ROS_INFO("Operational space move %s planned offline", planned->name.c_str());
+        if (addTrajectoryPoints(planned->jointPos, 0, planned->jointPos.cols(), Ts, 0, sendDerivatives ? &planned->jointVel : NULL,
+                                sendDerivatives ? &planned->jointAcc : NULL))
+            executeGoal(goalBuilder.getGoal(), planningStart);
+        return;
+    }
+
+    //same move already solved, from the same joints, with the joint velocities and accelerations when they are sent
+    TrajectoryCache::Key key = cacheKey("linear", pi, pf, PHI_i, PHI_f, ti, tf, Ts, q);
+    TrajectoryMatrix target_joints, target_vel, target_acc;
+    TrajectoryMatrix *vel = sendDerivatives ? &target_vel : NULL, *acc = sendDerivatives ? &target_acc : NULL;
+    if (trajectoryCache.lookup(key, target_joints, vel, acc))
+    {
+        ROS_INFO("Operational space move found in the trajectory cache");
+        if (addTrajectoryPoints(target_joints, 0, target_joints.cols(), Ts, 0, vel, acc))
+            executeGoal(goalBuilder.getGoal(), planningStart);
+        return;
+    }
 
-    //compute linear cartesian trajectory given starting/end position/orientation and time
-    trajectory = new CartesianTrajectory(pi, pf, PHI_i, PHI_f, ti, tf, Ts);
+    //compute linear cartesian trajectory given starting/end position/orientation and time,
+    //samples are evaluated while the IK consumes them
+    CartesianTrajectory trajectory(pi, pf, PHI_i, PHI_f, ti, tf, Ts, CartesianTrajectory::LAZY, orientationPath);
+    if (timeOptimal)
+    {
+        //same path, timed on its joint space image
+        std::shared_ptr<const PathTimingLaw> law = std::make_shared<PathTimingLaw>(ra.solvePath(trajectory, optimalPathPoints, q), jointLimits);
+        trajectory = CartesianTrajectory(pi, pf, PHI_i, PHI_f, law, Ts, CartesianTrajectory::LAZY, orientationPath);
+        ROS_INFO("Time optimal operational space move: %.2f s instead of %.2f s", law->getDuration(), tf - ti);
+    }
     std::cout << "Trajectory initialized!" << std::endl;
 
-    int length = trajectory->get_length();
-    KDL::JntArray target_joints;
-    std::vector<trajectory_msgs::JointTrajectoryPoint> points;
-
-    control_msgs::FollowJointTrajectoryGoal goal;
-    goal.trajectory.joint_names = {
-        "robot_arm_shoulder_pan_joint",
-        "robot_arm_shoulder_lift_joint",
-        "robot_arm_elbow_joint",
-        "robot_arm_wrist_1_joint",
-        "robot_arm_wrist_2_joint",
-        "robot_arm_wrist_3_joint"};
-
-    //build inverse kinematics for joint and each point in trajectory
-    for (int i = 0; i < length; i++)
+    if (streamChunk > 0)
     {
-        double vel_[6];
-        double acc_[6];
-        target_joints = ra.IKinematics(
-            trajectory->dataPosition.coeff(0, i),
-            trajectory->dataPosition.coeff(1, i),
-            trajectory->dataPosition.coeff(2, i),
-            trajectory->dataPosition.coeff(3, i), 
-            trajectory->dataPosition.coeff(4, i),
-            trajectory->dataPosition.coeff(5, i),
-            joints,
-            trajectory->dataVelocities,
-            i,
-            trajectory->dataAcceleration,
-            length,
-            vel_,
-            acc_);
-
-        bool check = true;
-        for (int j = 0; j < 6; j++)
-        {
-            //check if inverse kinematics provided joint values inside joint limits (-pi, pi)
-            if (target_joints.data[j] > 3.14 || target_joints.data[j] < -3.14)
-            {
-                check = false;
-                break;
-            }
-        }
+        if (streamTrajectory(trajectory, Ts, ra, target_joints, vel, acc, planningStart))
+            trajectoryCache.store(key, target_joints, vel, acc);
+        return;
+    }
+
+    int length = trajectory.get_length();
+
+    //build inverse kinematics for joint and each point in trajectory, warm started sample by sample,
+    //with the joint velocities and accelerations from the Jacobian of every solution
+    if (!solveMove(trajectory, q, ra, target_joints, vel, acc) || !addTrajectoryPoints(target_joints, 0, length, Ts, 0, vel, acc))
+        return;
+    trajectoryCache.store(key, target_joints, vel, acc);
+
+    //send all points to server in order to make it move
+    executeGoal(goalBuilder.getGoal(), planningStart);
+}
+
+//operational space path through the waypoints as a single goal, blended at the inner waypoints
+//and stopping only at the ones marked in stops; without time optimal laws every leg takes legDuration
+void sendWaypoints(const WaypointList &waypoints, const std::vector<bool> &stops, double legDuration, double Ts, RobotArm &ra)
+{
+    std::cout << "Initializing waypoint trajectory..." << std::endl;
+    Metrics::Clock::time_point planningStart = Metrics::Clock::now();
+    double q[6];
+    getJoints(q);
+
+    goalBuilder.clear();
 
-        if (check)
+    //every section between two stops is a blended path with its own timing law, starting and ending at rest
+    double offset = 0;
+    unsigned int first = 0;
+    for (unsigned int last = 1; last < waypoints.size(); last++)
+    {
+        if (last + 1 < waypoints.size() && !stops[last])
+            continue;
+
+        WaypointList section(waypoints.begin() + first, waypoints.begin() + last + 1);
+        std::shared_ptr<const BlendedPath> path = std::make_shared<BlendedPath>(section, blendDeviation);
+        CartesianTrajectory trajectory(path, 0, legDuration * (last - first), Ts, CartesianTrajectory::LAZY);
+        if (timeOptimal)
         {
-            //if all joints are "good" we can send trajectory to robot
-            std::cout << "Sending data to Ros" << std::endl;
-
-            trajectory_msgs::JointTrajectoryPoint point;
-            point.positions.resize(6);
-            point.positions = {
-                target_joints.data[0],
-                target_joints.data[1],
-                target_joints.data[2],
-                target_joints.data[3],
-                target_joints.data[4],
-                target_joints.data[5]};
-            point.time_from_start = ros::Duration(i * Ts);
-            points.push_back(point);
+            std::shared_ptr<const PathTimingLaw> law = std::make_shared<PathTimingLaw>(ra.solvePath(trajectory, optimalPathPoints, q), jointLimits);
+            trajectory = CartesianTrajectory(path, law, Ts, CartesianTrajectory::LAZY);
         }
-    }
 
-    goal.trajectory.points = points;
+        int length = trajectory.get_length();
+        TrajectoryMatrix target_joints, target_vel, target_acc;
+        TrajectoryMatrix *vel = sendDerivatives ? &target_vel : NULL, *acc = sendDerivatives ? &target_acc : NULL;
+        if (!solveMove(trajectory, q, ra, target_joints, vel, acc) || !addTrajectoryPoints(target_joints, 0, length, Ts, offset, vel, acc))
+            return;
+        ROS_INFO("Waypoints %u to %u in one section: %.2f s", first, last, trajectory.getDuration());
 
-    //send all points to server in order to make it move
-    ArmClient->sendGoalAndWait(goal);
+        //the next section starts where this one ends, seeds are in joint_states order
+        RobotArm::toSeed(target_joints.col(length - 1), q);
+
+        offset += length * Ts;
+        first = last;
+    }
+
+    executeGoal(goalBuilder.getGoal(), planningStart);
 }
 
 //trajectory in joint space
-void sendJointTraj(MatrixXd pi, MatrixXd pf, MatrixXd PHI_i, MatrixXd PHI_f, double ti, double tf, double Ts, RobotArm ra)
+void sendJointTraj(const Vector3d &pi, const Vector3d &pf, const Vector3d &PHI_i, const Vector3d &PHI_f, double ti, double tf, double Ts, RobotArm &ra)
 {
     std::cout << "Initializing joint space trajectory..." << std::endl;
-    JointPolTraj *trajectory;
+    Metrics::Clock::time_point planningStart = Metrics::Clock::now();
     //compute joint trajectory given starting/end position/orientation and time
-    trajectory = new JointPolTraj(pi, pf, PHI_i, PHI_f, ra, joints, 6, ti, tf, Ts);
-    MatrixXd jointPos = trajectory->getJointPos();
-    MatrixXd jointVel = trajectory->getJointVel();
-
-    control_msgs::FollowJointTrajectoryGoal goal;
-    goal.trajectory.joint_names = {
-        "robot_arm_shoulder_pan_joint",
-        "robot_arm_shoulder_lift_joint",
-        "robot_arm_elbow_joint",
-        "robot_arm_wrist_1_joint",
-        "robot_arm_wrist_2_joint",
-        "robot_arm_wrist_3_joint"};
-
-    std::vector<trajectory_msgs::JointTrajectoryPoint> points;
-    for (int i = 0; i < trajectory->getSamples(); i++)
+    double q[6];
+    getJoints(q);
+
+    goalBuilder.clear();
+
+    if (const PlannedSegment *planned = findPlannedMove(PlannedSegment::JOINT, pi, pf, PHI_i, PHI_f, ti, tf, Ts, q))
     {
-        trajectory_msgs::JointTrajectoryPoint point;
-
-        point.positions.resize(6);
-        point.time_from_start = ros::Duration(i * Ts);
-        point.positions = {
-            jointPos.coeff(0, i),
-            jointPos.coeff(1, i),
-            jointPos.coeff(2, i),
-            jointPos.coeff(3, i),
-            jointPos.coeff(4, i),
-            jointPos.coeff(5, i)};
-
-        points.push_back(point);
+        ROS_INFO("Joint space move %s planned offline", planned->name.c_str());
+        if (addTrajectoryPoints(planned->jointPos, 0, planned->jointPos.cols(), Ts, 0, sendDerivatives ? &planned->jointVel : NULL,
+                                sendDerivatives ? &planned->jointAcc : NULL))
+            executeGoal(goalBuilder.getGoal(), planningStart);
+        return;
     }
 
-    goal.trajectory.points = points;
-    ArmClient->sendGoalAndWait(goal);
+    TrajectoryCache::Key key = cacheKey("joint", pi, pf, PHI_i, PHI_f, ti, tf, Ts, q);
+    TrajectoryMatrix jointPos, jointVel, jointAcc;
+    if (trajectoryCache.lookup(key, jointPos, &jointVel, &jointAcc))
+    {
+        ROS_INFO("Joint space move found in the trajectory cache");
+    }
+    else
+    {
+        JointPolTraj trajectory = timeOptimal ? JointPolTraj(pi, pf, PHI_i, PHI_f, ra, q, 6, jointLimits, Ts)
+                                              : JointPolTraj(pi, pf, PHI_i, PHI_f, ra, q, 6, ti, tf, Ts);
+        jointPos = trajectory.getJointPos();
+        jointVel = trajectory.getJointVel();
+        jointAcc = trajectory.getJointAcc();
+        trajectoryCache.store(key, jointPos, &jointVel, &jointAcc);
+    }
+
+    if (addTrajectoryPoints(jointPos, 0, jointPos.cols(), Ts, 0, sendDerivatives ? &jointVel : NULL, sendDerivatives ? &jointAcc : NULL))
+        executeGoal(goalBuilder.getGoal(), planningStart);
 }
 
 //move the robot into a vertical position
 void goVertical()
 {
-    control_msgs::FollowJointTrajectoryGoal goal;
-    std::vector<trajectory_msgs::JointTrajectoryPoint> points;
-
-    goal.trajectory.joint_names = {
-        "robot_arm_shoulder_pan_joint",
-        "robot_arm_shoulder_lift_joint",
-        "robot_arm_elbow_joint",
-        "robot_arm_wrist_1_joint",
-        "robot_arm_wrist_2_joint",
-        "robot_arm_wrist_3_joint"};
+    goalBuilder.clear();
 
     //three points for the second joint are enough to make it go vertical from horizontal initial position
     double pos[]{0, -0.8, -PI2};
 
-    trajectory_msgs::JointTrajectoryPoint point;
+    Vector6d point;
     for (int i = 0; i < 3; i++)
     {
-        point.positions.resize(6);
-        point.positions = {0, pos[i], 0, 0, 0, 0};
-        point.time_from_start = ros::Duration(i);
-        points.push_back(point);
+        point << 0, pos[i], 0, 0, 0, 0;
+        goalBuilder.append(point, i);
     }
 
-    goal.trajectory.points = points;
-    ArmClient->sendGoalAndWait(goal);
+    executeGoal(goalBuilder.getGoal(), Metrics::Clock::now());
 }
 
 //pipeline for each aruco to pick and place it
 void pickAndPlaceSingleObject(
-    int arucoId, MatrixXd detectionP, MatrixXd detectionPHI, double marginX, double marginY, double marginZ, MatrixXd finalPHI,
-    ros::Rate loop_rate, RobotArm ra, double Ts, bool useJointTraj, int startTime, bool goHome)
+    int arucoId, const Vector3d &detectionP, const Vector3d &detectionPHI, double marginX, double marginY, double marginZ, const Vector3d &finalPHI,
+    ros::Rate &loop_rate, RobotArm &ra, double Ts, bool useJointTraj, int startTime, bool goHome)
 {
-    //Support matrices for trajectory computation
-    MatrixXd pf(3, 1);
-    MatrixXd PHI_f(3, 1);
-    MatrixXd pi(3, 1);
-    MatrixXd PHI_i(3, 1);
-    MatrixXd p_home(3, 1);
-    MatrixXd PHI_home(3, 1);
-    p_home << 0.077, -0.161, 1.123;
-    PHI_home << 0, -PI, -PI2;
+    //Support vectors for trajectory computation
+    Vector3d pf, PHI_f;
+    Vector3d pi, PHI_i;
+    const Vector3d p_home(0.077, -0.161, 1.123);
+    const Vector3d PHI_home(0, -PI, -PI2);
 
     double ti = 0.0;
     double tf = 4.0;
     double alpha, beta, gamma;
-    
-    KDL::Frame fr = ra.FKinematics(joints);
+    double q[6];
+    getJoints(q);
+
+    KDL::Frame fr = ra.FKinematics(q);
     pi << fr.p.x(), fr.p.y(), fr.p.z();
     fr.M.GetRPY(alpha, beta, gamma);
     PHI_i << alpha, beta, gamma;
@@ -368,39 +584,47 @@ void pickAndPlaceSingleObject(
     std::cout << "Moving to home... " << std::endl;
     pf = p_home;
     PHI_f = PHI_home;
-    if (goHome) {
-        sendTrajectory(pi, pf, PHI_i, PHI_f, 0, 4, Ts, ra);
+    if (goHome && blendMoves) {
+        //through home to the detection point in one goal, stopping only where the aruco is detected
+        std::cout << "Moving to detection point... " << std::endl;
+        WaypointList waypoints(3);
+        waypoints[0] << pi, PHI_i;
+        waypoints[1] << p_home, PHI_home;
+        waypoints[2] << detectionP, detectionPHI;
+        sendWaypoints(waypoints, {true, false, true}, 4, Ts, ra);
     } else {
-        sendJointTraj(pi, pf, PHI_i, PHI_f, 0, 4, Ts, ra);
-    }
+        if (goHome) {
+            sendTrajectory(pi, pf, PHI_i, PHI_f, 0, 4, Ts, ra);
+        } else {
+            sendJointTraj(pi, pf, PHI_i, PHI_f, 0, 4, Ts, ra);
+        }
 
-    pi = p_home;
-    PHI_i = PHI_home;
+        pi = p_home;
+        PHI_i = PHI_home;
 
-    //Settle to the detection point
-    std::cout << "Moving to detection point... " << std::endl;
+        //Settle to the detection point
+        std::cout << "Moving to detection point... " << std::endl;
 
-    pf = detectionP;
-    PHI_f = detectionPHI;
+        pf = detectionP;
+        PHI_f = detectionPHI;
 
-    // Use joint space trajectory to move the manipulator
-    sendTrajectory(pi, pf, PHI_i, PHI_f, 0, 4, Ts, ra);
+        // Use joint space trajectory to move the manipulator
+        sendTrajectory(pi, pf, PHI_i, PHI_f, 0, 4, Ts, ra);
+    }
 
     std::cout << "Aruco detection..." << std::endl;
 
-    geometry_msgs::TransformStamped transformStamped;
-
-    //check to see if transformStamped is initialized, wait 1 seconds for be sure to obatin the correct transformStamped
-    ros::Duration(1).sleep();
-    while (ros::ok() && abs(transformStamped.transform.translation.x) < 0.001 && abs(transformStamped.transform.translation.y) < 0.001 && abs(transformStamped.transform.translation.z) < 0.001)
+    //filtered pose of the aruco in the base frame, once it is fresh and stable
+    MarkerPose marker;
+    if (!markerCache.waitForMarker(arucoId, markerMaxAge, markerTimeout, marker, true))
     {
-        //read the aruco frame
-        transformStamped = getArucoTransformStamped(arucoId);
-        ros::spinOnce();
-        loop_rate.sleep();
+        ROS_ERROR("Aruco %d not detected with a stable pose within %.1f s, skipping it", arucoId, markerTimeout);
+        return;
     }
+    ROS_INFO("Aruco %d pose from %d samples, position std %.4f m", arucoId, marker.samples,
+             std::sqrt(marker.positionVariance.maxCoeff()));
 
-    pf << transformStamped.transform.translation.x, transformStamped.transform.translation.y, transformStamped.transform.translation.z;
+    pf = marker.basePose.translation();
 
     std::cout << "Aruco detected..." << std::endl;
 
@@ -425,33 +649,193 @@ int main(int argc, char **argv)
 
     RobotArm ra(n);
 
+    // Inverse kinematics backend, "lma" or "analytic" (UR5 closed form)
+    std::string ikBackend;
+    ros::NodeHandle private_n("~");
+    private_n.param("ik_backend", ikBackend, std::string("lma"));
+    if (ikBackend == "analytic")
+        ra.setIKBackend(RobotArm::IK_ANALYTIC);
+    private_n.param("parallel_ik", parallelIK, false);
+
+    // Checked IK, every sample within an iteration and time budget and verified with FK, also for streamed moves;
+    // it solves the samples in order, so it takes precedence over parallel_ik
+    RobotArm::IKBudget ikBudget;
+    private_n.param("checked_ik", checkedIK, false);
+    if (checkedIK && parallelIK)
+        ROS_WARN("checked_ik is set, parallel_ik is ignored");
+    private_n.param("ik_max_iterations", ikBudget.maxIterations, ikBudget.maxIterations);
+    private_n.param("ik_time_budget", ikBudget.maxTime, ikBudget.maxTime);
+    private_n.param("ik_retries", ikBudget.retries, ikBudget.retries);
+    private_n.param("ik_tolerance", ikBudget.tolerance, ikBudget.tolerance);
+    ra.setIKBudget(ikBudget);
+
+    // Workspace IK seeds built offline with rvc_seed_map, they warm start the single pose solves when they are on the
+    // branch of the current joints, and a solve failing from a map seed starts again from the current joints
+    std::string seedMapFileName;
+    if (private_n.getParam("seed_map", seedMapFileName))
+    {
+        std::shared_ptr<SeedMap> seedMap = std::make_shared<SeedMap>();
+        if (seedMap->open(seedMapFileName) && ra.setSeedMap(seedMap))
+            ROS_INFO("Loaded %u IK seeds from %s", (unsigned int)seedMap->getFilled(), seedMapFileName.c_str());
+        else
+            ROS_ERROR("Cannot load the IK seeds from %s, solving from the current joints", seedMapFileName.c_str());
+    }
+    private_n.param("stream_chunk", streamChunk, 0.0);
+    private_n.param("marker_max_age", markerMaxAge, 0.5);
+    private_n.param("marker_timeout", markerTimeout, 10.0);
+
+    // Time optimal moves, off unless asked for. Per joint limits default to the UR5 ones, and the moves use
+    // velocity_scale and acceleration_scale of them
+    private_n.param("time_optimal", timeOptimal, false);
+    private_n.param("optimal_path_points", optimalPathPoints, 100);
+    std::vector<double> velocityLimits, accelerationLimits;
+    if (private_n.getParam("joint_velocity_limits", velocityLimits) && velocityLimits.size() == 6)
+        jointLimits.velocity = Map<VectorXd>(velocityLimits.data(), 6);
+    if (private_n.getParam("joint_acceleration_limits", accelerationLimits) && accelerationLimits.size() == 6)
+        jointLimits.acceleration = Map<VectorXd>(accelerationLimits.data(), 6);
+    double velocityScale, accelerationScale;
+    private_n.param("velocity_scale", velocityScale, JointLimits::DEFAULT_SCALE);
+    private_n.param("acceleration_scale", accelerationScale, JointLimits::DEFAULT_SCALE);
+    if (!(velocityScale > 0 && velocityScale <= 1 && accelerationScale > 0 && accelerationScale <= 1))
+    {
+        ROS_WARN("Joint limit scales must be in (0, 1], using %.2f", JointLimits::DEFAULT_SCALE);
+        velocityScale = accelerationScale = JointLimits::DEFAULT_SCALE;
+    }
+    jointLimits = jointLimits.scaled(velocityScale, accelerationScale);
+    optimalPathPoints = std::max(optimalPathPoints, 3);
+    private_n.param("blend_moves", blendMoves, false);
+    private_n.param("blend_deviation", blendDeviation, 0.05);
+    private_n.param("send_derivatives", sendDerivatives, true);
+    std::string orientation;
+    private_n.param("orientation_path", orientation, std::string("rpy"));
+    if (orientation == "slerp")
+        orientationPath = CartesianTrajectory::SLERP;
+
+    // Marker pose filter, the task waits for a pose within marker_converged_std
+    MarkerPoseFilter::Parameters filterParameters;
+    private_n.param("marker_position_noise", filterParameters.positionNoise, filterParameters.positionNoise);
+    private_n.param("marker_converged_std", filterParameters.convergedStd, filterParameters.convergedStd);
+    private_n.param("marker_min_samples", filterParameters.minSamples, filterParameters.minSamples);
+    markerCache.setFilterParameters(filterParameters);
+
+    // Moves planned offline with rvc_planner, the others are still planned here
+    std::string taskFileName;
+    private_n.param("task_tolerance", taskTolerance, 1e-3);
+    private_n.param("task_joint_tolerance", taskJointTolerance, 0.05);
+    if (private_n.getParam("task_file", taskFileName))
+    {
+        if (taskFile.load(taskFileName))
+            ROS_INFO("Loaded %u planned moves from %s", (unsigned int)taskFile.getSegments().size(), taskFileName.c_str());
+        else
+            ROS_ERROR("Cannot load the planned moves from %s, planning every move online", taskFileName.c_str());
+    }
+
+    // Persistent cache of the solved moves, its tag changes with the robot model, the limits and the IK backend;
+    // trajectory_cache_size [MB] sizes a new file only, an existing cache keeps its size
+    std::string cacheFileName, robotDescription;
+    int cacheSize;
+    private_n.param("trajectory_cache_size", cacheSize, 64);
+    if (private_n.getParam("trajectory_cache", cacheFileName))
+    {
+        n.param("robot/robot_description", robotDescription, std::string());
+        uint64_t tag = TrajectoryCache::hash(robotDescription.data(), robotDescription.size());
+        tag = TrajectoryCache::hash(jointLimits.velocity.data(), jointLimits.velocity.size() * sizeof(double), tag);
+        tag = TrajectoryCache::hash(jointLimits.acceleration.data(), jointLimits.acceleration.size() * sizeof(double), tag);
+        tag = TrajectoryCache::hash(ikBackend.data(), ikBackend.size(), tag);
+        if (trajectoryCache.open(cacheFileName, tag, (size_t)std::max(cacheSize, 1) << 20))
+            ROS_INFO("Trajectory cache %s: %u moves", cacheFileName.c_str(), trajectoryCache.getEntries());
+        else
+            ROS_ERROR("Cannot map the trajectory cache %s, planning every move", cacheFileName.c_str());
+    }
+
+    // Metrics of planning, IK, vision and execution, exported every metrics_period seconds
+    std::string metricsFileName;
+    double metricsPeriod;
+    private_n.param("metrics_period", metricsPeriod, 5.0);
+    private_n.param("metrics_topic", metricsTopic, false);
+    if (private_n.getParam("metrics_csv", metricsFileName))
+    {
+        metricsCsv.open(metricsFileName.c_str());
+        if (metricsCsv)
+            Metrics::writeCsvHeader(metricsCsv);
+        else
+            ROS_ERROR("Cannot write the metrics to %s", metricsFileName.c_str());
+    }
+    if (metricsTopic)
+        metricsPub = private_n.advertise<std_msgs::String>("metrics", 1);
+    ros::WallTimer metricsTimer;
+    if (metricsCsv.is_open() || metricsTopic)
+    {
+        Metrics::setEnabled(true);
+        metricsTimer = n.createWallTimer(ros::WallDuration(metricsPeriod), exportMetrics);
+    }
+
     double Ts = 0.1;
     ros::Rate loop_rate(1 / Ts);
 
-    // Vision system
-    cameraSub = n.subscribe("/wrist_rgbd/color/camera_info", 1000, cameraCallback);
-    imageSub = n.subscribe("/wrist_rgbd/color/image_raw", 1000, imageCallback);
+    //one broadcaster for all the aruco frames, built once
+    tfBroadcaster.reset(new tf2_ros::TransformBroadcaster());
+
+    // Vision system, detection runs on its own thread on the newest frame only
+    bool showDetections;
+    int fullFrameInterval;
+    private_n.param("show_detections", showDetections, false);
+    private_n.param("full_frame_interval", fullFrameInterval, 10);
+
+    // Camera pose for the marker tracking: arm FK and the fixed flange to camera transform,
+    // looked up once on the worker thread as soon as tf has it
+    Eigen::Isometry3d toolToCamera;
+    bool toolToCameraKnown = false;
+    ArucoDetector::CameraPoseProvider cameraPose = [&](Eigen::Isometry3d &baseToCamera) {
+        if (!joints_done)
+            return false;
+        if (!toolToCameraKnown)
+        {
+            Metrics::ScopedTimer timer(Metrics::TF_LOOKUP_TIME);
+            if (!tfBuffer.canTransform("robot_arm_tool0", "robot_wrist_rgbd_color_optical_frame", ros::Time(0)))
+                return false;
+            geometry_msgs::TransformStamped t = tfBuffer.lookupTransform("robot_arm_tool0", "robot_wrist_rgbd_color_optical_frame", ros::Time(0));
+            toolToCamera = Eigen::Translation3d(t.transform.translation.x, t.transform.translation.y, t.transform.translation.z) *
+                           Eigen::Quaterniond(t.transform.rotation.w, t.transform.rotation.x, t.transform.rotation.y, t.transform.rotation.z);
+            toolToCameraKnown = true;
+        }
+
+        double q[6];
+        getJoints(q);
+        KDL::Frame fr = ra.FKinematics(q);
+        Eigen::Isometry3d baseToTool = Eigen::Isometry3d::Identity();
+        baseToTool.linear() = Eigen::Map<const Eigen::Matrix<double, 3, 3, Eigen::RowMajor>>(fr.M.data);
+        baseToTool.translation() << fr.p.x(), fr.p.y(), fr.p.z();
+        baseToCamera = baseToTool * toolToCamera;
+        return true;
+    };
+    ArucoDetector detector(0.03, markersCallback, showDetections, cameraPose, fullFrameInterval);
+    cameraSub = n.subscribe("/wrist_rgbd/color/camera_info", 1, &ArucoDetector::cameraInfoCallback, &detector);
+    imageSub = n.subscribe("/wrist_rgbd/color/image_raw", 1, &ArucoDetector::imageCallback, &detector);
 
     joint_state_sub = n.subscribe("/robot/joint_states", 1, jointsCallback);
 
+    //callbacks run on their own thread, also while the task blocks on trajectories and markers
+    ros::AsyncSpinner spinner(1);
+    spinner.start();
+
     createArmClient(ArmClient);
 
     //Buffer for lookupTransform, computation of aruco relative to robot_base_footprint
     tf2_ros::TransformListener tfListener(tfBuffer);
 
-    while (!joints_done)
+    while (ros::ok() && !joints_done)
     {
-        ros::spinOnce();
         loop_rate.sleep();
     };
 
     //Important 3D positions
-    MatrixXd p_vertical_pose(3, 1);
-    MatrixXd p_home(3, 1);
-    MatrixXd p_blueCube(3, 1);
-    MatrixXd p_redCube(3, 1);
-    MatrixXd p_greenCube(3, 1);
-    MatrixXd p_yellowCube(3, 1);
+    Vector3d p_vertical_pose;
+    Vector3d p_home;
+    Vector3d p_blueCube;
+    Vector3d p_redCube;
+    Vector3d p_greenCube;
+    Vector3d p_yellowCube;
 
     //manually defined positions for cube detection
     p_vertical_pose << 0, 0, 1.2;
@@ -462,11 +846,11 @@ int main(int argc, char **argv)
     p_home << 0.077, -0.161, 1.123;
 
     //Important 3D orientations
-    MatrixXd PHI_vertical_pose(3, 1);
-    MatrixXd PHI_blueCube(3, 1);
-    MatrixXd PHI_redCube(3, 1);
-    MatrixXd PHI_greenCube(3, 1);
-    MatrixXd PHI_yellowCube(3, 1);
+    Vector3d PHI_vertical_pose;
+    Vector3d PHI_blueCube;
+    Vector3d PHI_redCube;
+    Vector3d PHI_greenCube;
+    Vector3d PHI_yellowCube;
 
     PHI_vertical_pose << 0, 0, 0;
     PHI_blueCube << 0, -PI, -0.7;
@@ -474,7 +858,7 @@ int main(int argc, char **argv)
     PHI_greenCube << 0, -PI, -1.311;
     PHI_yellowCube << 0, -PI, -0.7;
 
-    MatrixXd PHI_parallel(3, 1);
+    Vector3d PHI_parallel;
     PHI_parallel << 0, -PI, -PI2;
 
     //Aruco id for each cube
@@ -506,9 +890,6 @@ int main(int argc, char **argv)
 
     pickAndPlaceSingleObject(yellowCubeArucoId, p_yellowCube, PHI_yellowCube, marginX, marginY, marginZ, PHI_yellowCube, loop_rate, ra, 0.1, false, 0, true);
 
-    while (ros::ok())
-    {
-        ros::spinOnce();
-    }
+    ros::waitForShutdown();
     return 0;
 }
\ No newline at end of file
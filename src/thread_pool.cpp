@@ -0,0 +1,138 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+// Constructor
+ThreadPool::ThreadPool(int nThreads) : queued(0), next(0), stopping(false)
+{
+    if (nThreads <= 0)
+        nThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (int i = 0; i < nThreads; i++)
+        queues.push_back(std::unique_ptr<TaskQueue>(new TaskQueue()));
+    for (int i = 0; i < nThreads; i++)
+        threads.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+    for (unsigned int i = 0; i < threads.size(); i++)
+        threads[i].join();
+}
+
+int ThreadPool::size() const
+{
+    return threads.size();
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    submit(std::move(task), all);
+}
+
+void ThreadPool::submit(std::function<void()> task, Batch &batch)
+{
+    batch.pending++;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    TaskQueue &queue = *queues[next];
+    next = (next + 1) % queues.size();
+    {
+        std::lock_guard<std::mutex> queueLock(queue.mutex);
+        queue.tasks.push_back(Task{std::move(task), &batch});
+    }
+    queued++;
+    lock.unlock();
+    wakeUp.notify_one();
+}
+
+//own deque first, newest task; then the oldest task of another deque. self < 0 only steals
+bool ThreadPool::popTask(int self, Task &task)
+{
+    if (self >= 0)
+    {
+        TaskQueue &own = *queues[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty())
+        {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            queued--;
+            return true;
+        }
+    }
+
+    int n = queues.size();
+    for (int k = 1; k <= n; k++)
+    {
+        int victim = (self + k + n) % n;
+        if (victim == self)
+            continue;
+        TaskQueue &other = *queues[victim];
+        std::lock_guard<std::mutex> lock(other.mutex);
+        if (!other.tasks.empty())
+        {
+            task = std::move(other.tasks.front());
+            other.tasks.pop_front();
+            queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+//the batch may be gone as soon as its counter reaches zero, it is not used after that
+void ThreadPool::runTask(Task &task)
+{
+    task.run();
+    task.run = nullptr;
+    if (--task.batch->pending == 0)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        idle.notify_all();
+    }
+}
+
+void ThreadPool::workerLoop(int self)
+{
+    Task task;
+    while (true)
+    {
+        if (popTask(self, task))
+        {
+            runTask(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        wakeUp.wait(lock, [this] { return stopping || queued > 0; });
+        if (stopping && queued == 0)
+            return;
+    }
+}
+
+void ThreadPool::wait()
+{
+    wait(all);
+}
+
+void ThreadPool::wait(Batch &batch)
+{
+    Task task;
+    while (batch.pending > 0)
+    {
+        if (popTask(-1, task))
+        {
+            runTask(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [this, &batch] { return batch.pending == 0 || queued > 0; });
+    }
+}
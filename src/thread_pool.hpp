@@ -0,0 +1,71 @@
+#ifndef THREAD_POOL
+#define THREAD_POOL
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//CLASS TO RUN TASKS ON A FIXED SET OF THREADS WITH WORK STEALING
+//each worker has its own deque: it takes the newest task from its own back,
+//and when it runs out it steals the oldest task from the front of the others
+class ThreadPool
+{
+public:
+    // Tasks waited for together, callers sharing the pool only wait for their own batch
+    struct Batch
+    {
+        Batch() : pending(0) {}
+
+        std::atomic<int> pending; // tasks submitted and not finished yet
+    };
+
+private:
+    struct Task
+    {
+        std::function<void()> run;
+        Batch *batch;
+    };
+
+    struct TaskQueue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<TaskQueue>> queues;
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;
+    std::condition_variable wakeUp; // new tasks or stop request
+    std::condition_variable idle;   // a batch has been run
+    std::atomic<int> queued;        // tasks waiting in the deques
+    Batch all;                      // tasks submitted without a batch
+    unsigned int next;              // deque receiving the next submitted task
+    bool stopping;
+
+    bool popTask(int self, Task &task);
+    void runTask(Task &task);
+    void workerLoop(int self);
+
+public:
+    // Constructor, zero threads means one per hardware core
+    explicit ThreadPool(int nThreads = 0);
+    ~ThreadPool();
+
+    int size() const;
+
+    void submit(std::function<void()> task);
+    void submit(std::function<void()> task, Batch &batch);
+
+    // Block until the tasks submitted without a batch, or those of the batch, have been run;
+    // the calling thread helps running queued tasks meanwhile
+    void wait();
+    void wait(Batch &batch);
+};
+
+#endif
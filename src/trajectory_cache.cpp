@@ -0,0 +1,325 @@
+#include "trajectory_cache.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char MAGIC[4] = {'R', 'V', 'C', 'C'};
+static const uint32_t VERSION = 2;
+
+const double TrajectoryCache::POSE_STEP = 1e-4;
+const double TrajectoryCache::TIME_STEP = 1e-6;
+const double TrajectoryCache::SEED_STEP = 1e-3;
+
+struct TrajectoryCache::Header
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t tag;
+    uint32_t slotCount;
+    uint32_t entries;
+    uint64_t dataCapacity; // doubles
+    uint64_t dataUsed;     // doubles
+};
+
+struct TrajectoryCache::Slot
+{
+    uint32_t full;
+    uint32_t samples;
+    uint32_t rows;   // 6 with the positions only, 18 with the velocities and accelerations after them
+    uint64_t offset; // doubles from the start of the data area
+    Key key;
+};
+
+// flock held for a scope, shared by readers and exclusive for writers, between processes
+class FileLock
+{
+private:
+    int fd;
+
+public:
+    FileLock(int fd, int operation) : fd(fd)
+    {
+        while (flock(fd, operation) != 0 && errno == EINTR)
+            ;
+    }
+    ~FileLock()
+    {
+        flock(fd, LOCK_UN);
+    }
+};
+
+static bool isFull(const uint32_t &full)
+{
+    return __atomic_load_n(&full, __ATOMIC_ACQUIRE) != 0;
+}
+
+static int64_t quantize(double value, double step)
+{
+    return std::llround(value / step);
+}
+
+bool TrajectoryCache::Key::operator==(const Key &other) const
+{
+    return std::equal(values, values + KEY_SIZE, other.values);
+}
+
+// Constructor
+TrajectoryCache::TrajectoryCache() : fd(-1), map(NULL), mapSize(0), header(NULL), slots(NULL), data(NULL), slotCount(0), dataCapacity(0)
+{
+}
+
+TrajectoryCache::~TrajectoryCache()
+{
+    close();
+}
+
+TrajectoryCache::Key TrajectoryCache::makeKey(int64_t kind, const Eigen::Vector3d &pi, const Eigen::Vector3d &pf, const Eigen::Vector3d &PHI_i,
+                                              const Eigen::Vector3d &PHI_f, double ti, double tf, double Ts, const double seed[6])
+{
+    Key key;
+    int64_t *v = key.values;
+    *v++ = kind;
+    for (int i = 0; i < 3; i++)
+    {
+        *v++ = quantize(pi(i), POSE_STEP);
+        *v++ = quantize(pf(i), POSE_STEP);
+        *v++ = quantize(PHI_i(i), POSE_STEP);
+        *v++ = quantize(PHI_f(i), POSE_STEP);
+    }
+    *v++ = quantize(ti, TIME_STEP);
+    *v++ = quantize(tf, TIME_STEP);
+    *v++ = quantize(Ts, TIME_STEP);
+    for (int i = 0; i < 6; i++)
+        *v++ = quantize(seed[i], SEED_STEP);
+    return key;
+}
+
+uint64_t TrajectoryCache::hash(const void *bytes, size_t size, uint64_t seed)
+{
+    const unsigned char *p = static_cast<const unsigned char *>(bytes);
+    uint64_t h = seed;
+    for (size_t i = 0; i < size; i++)
+    {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+uint64_t TrajectoryCache::keyHash(const Key &key)
+{
+    return hash(key.values, sizeof(key.values));
+}
+
+bool TrajectoryCache::open(const std::string &fileName, uint64_t tag, size_t dataBytes, unsigned int slotCount)
+{
+    close();
+    std::lock_guard<std::mutex> lock(mutex);
+
+    fd = ::open(fileName.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+        return false;
+
+    // Sizes are read and the file is resized under the exclusive lock, so that no process resizes a file another
+    // one is creating
+    bool mapped;
+    {
+        FileLock fileLock(fd, LOCK_EX);
+        mapped = mapFile(tag, dataBytes, slotCount);
+    }
+    if (!mapped)
+    {
+        ::close(fd);
+        fd = -1;
+    }
+    return mapped;
+}
+
+//maps the open file: a cache file already there keeps the sizes it was created with, by this or another process,
+//anything else is resized for dataBytes and slotCount and initialized
+bool TrajectoryCache::mapFile(uint64_t tag, size_t dataBytes, unsigned int slotCount)
+{
+    // Power of two table, probed linearly
+    unsigned int count = 16;
+    while (count < slotCount)
+        count <<= 1;
+    uint64_t capacity = std::max<size_t>(dataBytes / sizeof(double), 6);
+
+    struct stat st;
+    Header existing;
+    if (fstat(fd, &st) != 0)
+        return false;
+    uint64_t fileSize = st.st_size;
+    bool valid = fileSize >= sizeof(Header) && pread(fd, &existing, sizeof(Header), 0) == (ssize_t)sizeof(Header) &&
+                 std::equal(existing.magic, existing.magic + 4, MAGIC) && existing.version == VERSION && existing.slotCount >= 16 &&
+                 (existing.slotCount & (existing.slotCount - 1)) == 0 && existing.dataCapacity >= 6 &&
+                 existing.dataCapacity <= fileSize / sizeof(double) &&
+                 fileSize == sizeof(Header) + existing.slotCount * sizeof(Slot) + existing.dataCapacity * sizeof(double);
+    if (valid)
+    {
+        count = existing.slotCount;
+        capacity = existing.dataCapacity;
+    }
+    size_t size = sizeof(Header) + count * sizeof(Slot) + capacity * sizeof(double);
+    if (!valid && ftruncate(fd, size) != 0)
+        return false;
+
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        map = NULL;
+        return false;
+    }
+    mapSize = size;
+    this->slotCount = count;
+    dataCapacity = capacity;
+    header = static_cast<Header *>(map);
+    slots = reinterpret_cast<Slot *>(header + 1);
+    data = reinterpret_cast<double *>(slots + count);
+
+    if (!valid || header->tag != tag || header->dataUsed > dataCapacity)
+    {
+        std::copy(MAGIC, MAGIC + 4, header->magic);
+        header->version = VERSION;
+        header->slotCount = count;
+        header->dataCapacity = dataCapacity;
+        reset(tag);
+    }
+    return true;
+}
+
+void TrajectoryCache::close()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (map != NULL)
+    {
+        msync(map, mapSize, MS_SYNC);
+        munmap(map, mapSize);
+    }
+    if (fd >= 0)
+        ::close(fd);
+    fd = -1;
+    map = NULL;
+    mapSize = 0;
+    header = NULL;
+    slots = NULL;
+    data = NULL;
+    slotCount = 0;
+    dataCapacity = 0;
+}
+
+bool TrajectoryCache::isOpen() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return map != NULL;
+}
+
+void TrajectoryCache::reset(uint64_t tag)
+{
+    header->tag = tag;
+    header->entries = 0;
+    header->dataUsed = 0;
+    std::memset(slots, 0, slotCount * sizeof(Slot));
+}
+
+//slot holding the key, or the empty one where it would go; NULL when every slot holds another key,
+//which only a foreign file can do
+TrajectoryCache::Slot *TrajectoryCache::findSlot(const Key &key) const
+{
+    uint32_t mask = slotCount - 1;
+    uint32_t i = keyHash(key) & mask;
+    for (uint32_t probes = 0; probes < slotCount; probes++, i = (i + 1) & mask)
+        if (!isFull(slots[i].full) || slots[i].key == key)
+            return &slots[i];
+    return NULL;
+}
+
+bool TrajectoryCache::lookup(const Key &key, TrajectoryMatrix &jointPos, TrajectoryMatrix *jointVel, TrajectoryMatrix *jointAcc) const
+{
+    bool derivatives = jointVel != NULL && jointAcc != NULL;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (map == NULL)
+        return false;
+
+    // A slot pointing out of the data written so far is corrupt or foreign, a miss
+    FileLock fileLock(fd, LOCK_SH);
+    const Slot *slot = findSlot(key);
+    if (slot == NULL || !isFull(slot->full))
+        return false;
+    uint64_t used = header->dataUsed, offset = slot->offset, samples = slot->samples, rows = slot->rows;
+    if ((rows != 6 && rows != 18) || used > dataCapacity || offset > used || samples > (used - offset) / rows)
+        return false;
+    if (derivatives && rows != 18)
+        return false;
+    jointPos = Eigen::Map<const TrajectoryMatrix>(data + offset, 6, samples);
+    if (derivatives)
+    {
+        *jointVel = Eigen::Map<const TrajectoryMatrix>(data + offset + 6 * samples, 6, samples);
+        *jointAcc = Eigen::Map<const TrajectoryMatrix>(data + offset + 12 * samples, 6, samples);
+    }
+    return true;
+}
+
+bool TrajectoryCache::store(const Key &key, const TrajectoryMatrix &jointPos, const TrajectoryMatrix *jointVel, const TrajectoryMatrix *jointAcc)
+{
+    bool derivatives = jointVel != NULL && jointAcc != NULL && jointVel->cols() == jointPos.cols() && jointAcc->cols() == jointPos.cols();
+    uint64_t size = (derivatives ? 3 : 1) * (uint64_t)jointPos.size();
+    std::lock_guard<std::mutex> lock(mutex);
+    if (map == NULL || size > dataCapacity)
+        return false;
+
+    // Table at most three quarters full, so that probes stay short
+    FileLock fileLock(fd, LOCK_EX);
+    Slot *slot = findSlot(key);
+    if (slot == NULL || header->dataUsed > dataCapacity || header->dataUsed + size > dataCapacity ||
+        (!slot->full && (header->entries + 1) * 4 > slotCount * 3))
+    {
+        reset(header->tag);
+        slot = findSlot(key);
+    }
+
+    // Data first, the slot is published last with a release store, so that an interrupted store leaves no entry
+    // and a reader seeing the slot full sees its data
+    uint64_t offset = header->dataUsed;
+    std::copy(jointPos.data(), jointPos.data() + jointPos.size(), data + offset);
+    if (derivatives)
+    {
+        std::copy(jointVel->data(), jointVel->data() + jointPos.size(), data + offset + jointPos.size());
+        std::copy(jointAcc->data(), jointAcc->data() + jointPos.size(), data + offset + 2 * jointPos.size());
+    }
+    header->dataUsed = offset + size;
+    if (!slot->full)
+        header->entries++;
+    __atomic_store_n(&slot->full, 0, __ATOMIC_RELEASE);
+    slot->key = key;
+    slot->offset = offset;
+    slot->samples = jointPos.cols();
+    slot->rows = derivatives ? 18 : 6;
+    __atomic_store_n(&slot->full, 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+void TrajectoryCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (map == NULL)
+        return;
+    FileLock fileLock(fd, LOCK_EX);
+    reset(header->tag);
+}
+
+// GETTERS
+
+unsigned int TrajectoryCache::getEntries() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return map != NULL ? header->entries : 0;
+}
@@ -0,0 +1,95 @@
+#ifndef TRAJECTORY_CACHE
+#define TRAJECTORY_CACHE
+
+#include <Eigen/Eigen>
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "trajectory_types.hpp"
+
+//CLASS TO KEEP SOLVED JOINT TRAJECTORIES IN A MEMORY MAPPED FILE, ACROSS RESTARTS
+//entries are addressed by the quantized planning inputs; the file holds a header, an open addressing
+//table of fixed size slots (full key, offset, number of samples and rows) and an append only area with the
+//joint positions, followed by their velocities and accelerations when they were stored. When the table or the data area is full the cache starts over empty.
+//The tag stored in the header identifies the robot model and planning settings, a file with another
+//tag is cleared when opened. Several processes can share the file: writers take an exclusive flock on it,
+//readers a shared one, and a slot is published by a release store of its full flag after its data
+class TrajectoryCache
+{
+public:
+    enum
+    {
+        KEY_SIZE = 22 // kind, pi, pf, PHI_i, PHI_f, ti, tf, Ts, seed
+    };
+
+    struct Key
+    {
+        int64_t values[KEY_SIZE];
+
+        bool operator==(const Key &other) const;
+    };
+
+    // Quantization steps of the inputs
+    static const double POSE_STEP; // [m], [rad]
+    static const double TIME_STEP; // [s]
+    static const double SEED_STEP; // [rad]
+
+private:
+    struct Header;
+    struct Slot;
+
+    mutable std::mutex mutex;
+    int fd;
+    void *map;
+    size_t mapSize;
+    Header *header;
+    Slot *slots;
+    double *data;
+    uint32_t slotCount;    // sizes of the mapping, the header can be rewritten by another process
+    uint64_t dataCapacity; // doubles
+
+    bool mapFile(uint64_t tag, size_t dataBytes, unsigned int slotCount);
+    static uint64_t keyHash(const Key &key);
+    Slot *findSlot(const Key &key) const;
+    void reset(uint64_t tag);
+
+public:
+    TrajectoryCache();
+    ~TrajectoryCache();
+    TrajectoryCache(const TrajectoryCache &) = delete;
+    TrajectoryCache &operator=(const TrajectoryCache &) = delete;
+
+    // Key of a move; kind tells apart the planners and settings producing different trajectories for the same
+    // inputs, seed is in joint_states order
+    static Key makeKey(int64_t kind, const Eigen::Vector3d &pi, const Eigen::Vector3d &pf, const Eigen::Vector3d &PHI_i, const Eigen::Vector3d &PHI_f,
+                       double ti, double tf, double Ts, const double seed[6]);
+
+    // FNV-1a, to build tags and kinds
+    static uint64_t hash(const void *bytes, size_t size, uint64_t seed = 14695981039346656037ULL);
+
+    // Maps the file, creating it with room for dataBytes of joint trajectories and slotCount entries when it does not
+    // exist or is not a cache file; a cache file keeps its sizes, it may be in use by other processes. False if it
+    // cannot be mapped
+    bool open(const std::string &fileName, uint64_t tag, size_t dataBytes = 64 << 20, unsigned int slotCount = 4096);
+    void close();
+    bool isOpen() const;
+
+    // Joint positions (6, samples) stored for the key, and their velocities and accelerations when both are given;
+    // false on a miss, also when the derivatives are asked for and the entry has none
+    bool lookup(const Key &key, TrajectoryMatrix &jointPos, TrajectoryMatrix *jointVel = NULL, TrajectoryMatrix *jointAcc = NULL) const;
+
+    // Stores (or replaces) the joint positions of the key, with their velocities and accelerations when both are given;
+    // false if they do not fit even in an empty cache
+    bool store(const Key &key, const TrajectoryMatrix &jointPos, const TrajectoryMatrix *jointVel = NULL,
+               const TrajectoryMatrix *jointAcc = NULL);
+
+    void clear();
+
+    // Getters
+    unsigned int getEntries() const;
+};
+
+#endif
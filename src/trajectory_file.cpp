@@ -0,0 +1,167 @@
+#include "trajectory_file.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+
+static const char MAGIC[4] = {'R', 'V', 'C', 'T'};
+static const uint32_t VERSION = 3;
+
+// Bytes of the header and of a segment without its name and samples
+static const uint64_t HEADER_SIZE = 4 + 2 * sizeof(uint32_t);
+static const uint64_t SEGMENT_SIZE = 2 * sizeof(uint32_t) + 2 * sizeof(uint8_t) + 2 * sizeof(double) + 4 * 6 * sizeof(double);
+
+// Bounds of a sane file, far above any task
+static const uint32_t MAX_SEGMENTS = 1 << 16;
+static const uint32_t MAX_NAME_LENGTH = 1 << 12;
+static const uint32_t MAX_SAMPLES = 1 << 22;
+
+// Largest difference between two poses, angles compared modulo 2 pi
+static double poseDistance(const Vector6d &a, const Vector6d &b)
+{
+    double distance = (a.head<3>() - b.head<3>()).cwiseAbs().maxCoeff();
+    for (int i = 3; i < 6; i++)
+        distance = std::max(distance, std::abs(std::remainder(a(i) - b(i), 2 * M_PI)));
+    return distance;
+}
+
+template <typename T>
+static void writeValue(std::ostream &out, const T &value)
+{
+    out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T>
+static bool readValue(std::istream &in, T &value)
+{
+    return (bool)in.read(reinterpret_cast<char *>(&value), sizeof(T));
+}
+
+bool TrajectoryFile::load(const std::string &fileName)
+{
+    segments.clear();
+    std::ifstream in(fileName.c_str(), std::ios::binary | std::ios::ate);
+    if (!in)
+        return false;
+    uint64_t remaining = (uint64_t)in.tellg();
+    in.seekg(0);
+
+    char magic[4];
+    uint32_t version, count;
+    if (!in.read(magic, 4) || !std::equal(magic, magic + 4, MAGIC) || !readValue(in, version) || version != VERSION || !readValue(in, count))
+        return false;
+    remaining -= HEADER_SIZE;
+
+    // Every size is checked against what is left of the file before anything is allocated for it
+    if (count > MAX_SEGMENTS || count * SEGMENT_SIZE > remaining)
+        return false;
+
+    segments.resize(count);
+    for (uint32_t k = 0; k < count; k++)
+    {
+        PlannedSegment &segment = segments[k];
+        uint32_t nameLength, samples;
+        uint8_t type, timing;
+        if (!readValue(in, nameLength) || nameLength > MAX_NAME_LENGTH || SEGMENT_SIZE + nameLength > remaining)
+        {
+            in.setstate(std::ios::failbit);
+            break;
+        }
+        remaining -= SEGMENT_SIZE + nameLength;
+        segment.name.resize(nameLength);
+        if (!in.read(&segment.name[0], nameLength) || !readValue(in, type) || !readValue(in, timing) ||
+            !readValue(in, segment.duration) ||
+            !in.read(reinterpret_cast<char *>(segment.velocityLimits.data()), sizeof(double) * 6) ||
+            !in.read(reinterpret_cast<char *>(segment.accelerationLimits.data()), sizeof(double) * 6) || !readValue(in, segment.Ts) ||
+            !in.read(reinterpret_cast<char *>(segment.start.data()), sizeof(double) * 6) ||
+            !in.read(reinterpret_cast<char *>(segment.end.data()), sizeof(double) * 6) || !readValue(in, samples))
+            break;
+        if (type > PlannedSegment::JOINT || timing > PlannedSegment::OPTIMAL || samples > MAX_SAMPLES ||
+            sizeof(double) * 18 * (uint64_t)samples > remaining)
+        {
+            in.setstate(std::ios::failbit);
+            break;
+        }
+        remaining -= sizeof(double) * 18 * (uint64_t)samples;
+        segment.type = (PlannedSegment::Type)type;
+        segment.timing = (PlannedSegment::Timing)timing;
+        segment.jointPos.resize(6, samples);
+        segment.jointVel.resize(6, samples);
+        segment.jointAcc.resize(6, samples);
+        if (!in.read(reinterpret_cast<char *>(segment.jointPos.data()), sizeof(double) * 6 * samples) ||
+            !in.read(reinterpret_cast<char *>(segment.jointVel.data()), sizeof(double) * 6 * samples) ||
+            !in.read(reinterpret_cast<char *>(segment.jointAcc.data()), sizeof(double) * 6 * samples))
+            break;
+    }
+
+    // Truncated or corrupt file
+    if (!in)
+    {
+        segments.clear();
+        return false;
+    }
+    return true;
+}
+
+bool TrajectoryFile::save(const std::string &fileName) const
+{
+    std::ofstream out(fileName.c_str(), std::ios::binary | std::ios::trunc);
+    out.write(MAGIC, 4);
+    writeValue(out, VERSION);
+    writeValue(out, (uint32_t)segments.size());
+
+    for (unsigned int k = 0; k < segments.size(); k++)
+    {
+        const PlannedSegment &segment = segments[k];
+        writeValue(out, (uint32_t)segment.name.size());
+        out.write(segment.name.data(), segment.name.size());
+        writeValue(out, (uint8_t)segment.type);
+        writeValue(out, (uint8_t)segment.timing);
+        writeValue(out, segment.duration);
+        out.write(reinterpret_cast<const char *>(segment.velocityLimits.data()), sizeof(double) * 6);
+        out.write(reinterpret_cast<const char *>(segment.accelerationLimits.data()), sizeof(double) * 6);
+        writeValue(out, segment.Ts);
+        out.write(reinterpret_cast<const char *>(segment.start.data()), sizeof(double) * 6);
+        out.write(reinterpret_cast<const char *>(segment.end.data()), sizeof(double) * 6);
+        writeValue(out, (uint32_t)segment.jointPos.cols());
+        out.write(reinterpret_cast<const char *>(segment.jointPos.data()), sizeof(double) * segment.jointPos.size());
+        out.write(reinterpret_cast<const char *>(segment.jointVel.data()), sizeof(double) * segment.jointPos.size());
+        out.write(reinterpret_cast<const char *>(segment.jointAcc.data()), sizeof(double) * segment.jointPos.size());
+    }
+    return (bool)out.flush();
+}
+
+void TrajectoryFile::add(const PlannedSegment &segment)
+{
+    segments.push_back(segment);
+}
+
+void TrajectoryFile::clear()
+{
+    segments.clear();
+}
+
+const PlannedSegment *TrajectoryFile::find(PlannedSegment::Type type, const Vector6d &start, const Vector6d &end, double tolerance,
+                                           PlannedSegment::Timing timing, double duration, const JointLimits &limits) const
+{
+    for (unsigned int k = 0; k < segments.size(); k++)
+    {
+        const PlannedSegment &segment = segments[k];
+        if (segment.type != type || segment.timing != timing || poseDistance(segment.start, start) > tolerance ||
+            poseDistance(segment.end, end) > tolerance)
+            continue;
+
+        if (timing == PlannedSegment::FIXED && std::abs(segment.duration - duration) <= 1e-9)
+            return &segment;
+        if (timing == PlannedSegment::OPTIMAL && limits.velocity.size() == 6 && limits.acceleration.size() == 6 &&
+            (segment.velocityLimits - limits.velocity).cwiseAbs().maxCoeff() <= 1e-9 &&
+            (segment.accelerationLimits - limits.acceleration).cwiseAbs().maxCoeff() <= 1e-9)
+            return &segment;
+    }
+    return NULL;
+}
+
+// GETTERS
+
+const PlannedSegmentList &TrajectoryFile::getSegments() const { return segments; }
@@ -0,0 +1,70 @@
+#ifndef TRAJECTORY_FILE
+#define TRAJECTORY_FILE
+
+#include <Eigen/Eigen>
+#include <Eigen/StdVector>
+
+#include <string>
+#include <vector>
+
+#include "trajectory_types.hpp"
+#include "path_timing_law.hpp"
+
+// Joint trajectory of one move, planned offline
+struct PlannedSegment
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    enum Type
+    {
+        LINEAR, // straight line in operational space
+        JOINT   // straight line in joint space
+    };
+
+    enum Timing
+    {
+        FIXED,  // in the given duration
+        OPTIMAL // time optimal under the joint limits
+    };
+
+    std::string name;
+    Type type;
+    Timing timing;
+    double duration;                              // [s] given one of FIXED moves, resulting one of OPTIMAL moves
+    Vector6d velocityLimits, accelerationLimits;  // joint limits OPTIMAL moves were timed with
+    double Ts;
+    Vector6d start, end;       // poses (position, RPY angles) the move goes between
+    TrajectoryMatrix jointPos; // (6, samples), chain order, one sample every Ts from the start
+    TrajectoryMatrix jointVel; // (6, samples) joint velocities of the samples
+    TrajectoryMatrix jointAcc; // (6, samples) joint accelerations of the samples
+};
+
+typedef std::vector<PlannedSegment, Eigen::aligned_allocator<PlannedSegment>> PlannedSegmentList;
+
+//CLASS TO STORE PLANNED JOINT TRAJECTORIES IN A BINARY FILE
+//a header (magic, version, number of segments) followed by every segment: name, type, timing, duration, joint
+//limits, Ts, start and end poses, number of samples and the joint positions, velocities and accelerations as raw
+//doubles in column order, native endianness
+class TrajectoryFile
+{
+private:
+    PlannedSegmentList segments;
+
+public:
+    // False if the file cannot be read or is not a trajectory file, segments are left empty
+    bool load(const std::string &fileName);
+    bool save(const std::string &fileName) const;
+
+    void add(const PlannedSegment &segment);
+    void clear();
+
+    // Segment of the given type between poses within tolerance of start and end (angles are wrapped), NULL if none.
+    // FIXED segments have to last duration, OPTIMAL ones to be timed with the same joint limits
+    const PlannedSegment *find(PlannedSegment::Type type, const Vector6d &start, const Vector6d &end, double tolerance,
+                               PlannedSegment::Timing timing, double duration, const JointLimits &limits) const;
+
+    // Getters
+    const PlannedSegmentList &getSegments() const;
+};
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef TRAJECTORY_TYPES
+#define TRAJECTORY_TYPES
+
+#include <Eigen/Eigen>
+#include <Eigen/Dense>
+
+// Samples of a 6 dimensional trajectory (pose, twist or joints), one column per sample
+typedef Eigen::Matrix<double, 6, Eigen::Dynamic> TrajectoryMatrix;
+
+// Single sample
+typedef Eigen::Matrix<double, 6, 1> Vector6d;
+
+#endif
@@ -0,0 +1,120 @@
+#include "ur5_batch_fk.hpp"
+
+#include <algorithm>
+
+namespace
+{
+// One configuration at a time, for the remainder of the packs and CPUs without vector units
+struct ScalarPack
+{
+    enum
+    {
+        WIDTH = 1
+    };
+    double v;
+
+    static ScalarPack load(const double *p) { return ScalarPack{*p}; }
+    static ScalarPack broadcast(double x) { return ScalarPack{x}; }
+    static ScalarPack floor(const ScalarPack &a) { return ScalarPack{std::floor(a.v)}; }
+    void store(double *p) const { *p = v; }
+
+    ScalarPack operator+(const ScalarPack &b) const { return ScalarPack{v + b.v}; }
+    ScalarPack operator-(const ScalarPack &b) const { return ScalarPack{v - b.v}; }
+    ScalarPack operator*(const ScalarPack &b) const { return ScalarPack{v * b.v}; }
+};
+
+bool cpuHas(UR5BatchFK::Backend backend)
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    if (backend == UR5BatchFK::AVX2)
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    if (backend == UR5BatchFK::AVX512)
+        return __builtin_cpu_supports("avx512f");
+#endif
+    return backend == UR5BatchFK::SCALAR;
+}
+
+void copyRows(const Eigen::Isometry3d &pose, double rows[12])
+{
+    for (int r = 0; r < 3; r++)
+        for (int k = 0; k < 4; k++)
+            rows[r * 4 + k] = pose.matrix()(r, k);
+}
+}
+
+// Constructor
+UR5BatchFK::UR5BatchFK(const UR5Kinematics &model)
+{
+    const double a[6] = {0, model.getA2(), model.getA3(), 0, 0, 0};
+    const double d[6] = {model.getD1(), 0, 0, model.getD4(), model.getD5(), model.getD6()};
+    // Same exact twists as UR5Kinematics
+    const double sinAlpha[6] = {1, 0, 0, 1, -1, 0};
+    const double cosAlpha[6] = {0, 1, 1, 0, 0, 1};
+    std::copy(a, a + 6, parameters.a);
+    std::copy(d, d + 6, parameters.d);
+    std::copy(sinAlpha, sinAlpha + 6, parameters.sinAlpha);
+    std::copy(cosAlpha, cosAlpha + 6, parameters.cosAlpha);
+    copyRows(model.getBase(), parameters.base);
+    copyRows(model.getTool(), parameters.tool);
+
+    backend = bestBackend();
+}
+
+bool UR5BatchFK::isSupported(Backend backend)
+{
+    if (backend == AVX2)
+        return ur5_batch_fk::avx2Built() && cpuHas(AVX2);
+    if (backend == AVX512)
+        return ur5_batch_fk::avx512Built() && cpuHas(AVX512);
+    return backend == SCALAR;
+}
+
+UR5BatchFK::Backend UR5BatchFK::bestBackend()
+{
+    if (isSupported(AVX512))
+        return AVX512;
+    if (isSupported(AVX2))
+        return AVX2;
+    return SCALAR;
+}
+
+bool UR5BatchFK::setBackend(Backend backend)
+{
+    if (!isSupported(backend))
+        return false;
+    this->backend = backend;
+    return true;
+}
+
+void UR5BatchFK::forward(const double *const q[6], int n, double *const position[3], double *const rotation[9]) const
+{
+    int done = 0;
+    if (backend == AVX512)
+        done = ur5_batch_fk::forwardAvx512(parameters, q, n, position, rotation);
+    else if (backend == AVX2)
+        done = ur5_batch_fk::forwardAvx2(parameters, q, n, position, rotation);
+    ur5_batch_fk::forward<ScalarPack>(parameters, q, done, n, position, rotation);
+}
+
+void UR5BatchFK::forward(const JointBatch &q, PositionBatch &positions, RotationBatch &rotations) const
+{
+    int n = q.rows();
+    positions.resize(n, 3);
+    rotations.resize(n, 9);
+
+    // Column major, so every column is one of the arrays
+    const double *joints[6];
+    double *position[3], *rotation[9];
+    for (int j = 0; j < 6; j++)
+        joints[j] = q.col(j).data();
+    for (int i = 0; i < 3; i++)
+        position[i] = positions.col(i).data();
+    for (int i = 0; i < 9; i++)
+        rotation[i] = rotations.col(i).data();
+    forward(joints, n, position, rotation);
+}
+
+// GETTERS
+
+UR5BatchFK::Backend UR5BatchFK::getBackend() const { return backend; }
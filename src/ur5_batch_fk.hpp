@@ -0,0 +1,50 @@
+#ifndef UR5_BATCH_FK
+#define UR5_BATCH_FK
+
+#include <Eigen/Eigen>
+
+#include "ur5_kinematics.hpp"
+#include "ur5_batch_fk_kernel.hpp"
+
+//CLASS FOR THE FORWARD KINEMATICS OF MANY UR5 CONFIGURATIONS AT ONCE
+//configurations are given as a structure of arrays (one array per joint, chain order) and evaluated a pack
+//at a time with AVX-512 or AVX2 when the CPU has them, the remainder and other CPUs go through the scalar kernel.
+//Sines and cosines are polynomial approximations, within a few ulp of the libm ones for angles of a few turns
+class UR5BatchFK
+{
+public:
+    enum Backend
+    {
+        SCALAR,
+        AVX2,  // 4 configurations per pack
+        AVX512 // 8 configurations per pack
+    };
+
+    // Batch of configurations, one column per joint so every joint is contiguous
+    typedef Eigen::Matrix<double, Eigen::Dynamic, 6> JointBatch;
+    typedef Eigen::Matrix<double, Eigen::Dynamic, 3> PositionBatch;
+    typedef Eigen::Matrix<double, Eigen::Dynamic, 9> RotationBatch; // row major rotation matrices, one per row
+
+private:
+    UR5BatchFKParameters parameters;
+    Backend backend;
+
+public:
+    // Constructor, same geometry and mounting frames as the model; the backend is the best one the CPU runs
+    explicit UR5BatchFK(const UR5Kinematics &model);
+
+    static bool isSupported(Backend backend);
+    static Backend bestBackend();
+
+    // False and unchanged if the CPU does not run it
+    bool setBackend(Backend backend);
+    Backend getBackend() const;
+
+    // Tool pose of n configurations: q[joint][i] in, position[axis][i] and rotation[row * 3 + column][i] out
+    void forward(const double *const q[6], int n, double *const position[3], double *const rotation[9]) const;
+
+    // Same on Eigen batches, outputs are resized to the number of configurations
+    void forward(const JointBatch &q, PositionBatch &positions, RotationBatch &rotations) const;
+};
+
+#endif
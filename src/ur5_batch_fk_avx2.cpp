@@ -0,0 +1,43 @@
+// Built with -mavx2 -mfma, called only after UR5BatchFK checked the CPU
+#include "ur5_batch_fk_kernel.hpp"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+
+namespace
+{
+struct Avx2Pack
+{
+    enum
+    {
+        WIDTH = 4
+    };
+    __m256d v;
+
+    static Avx2Pack load(const double *p) { return Avx2Pack{_mm256_loadu_pd(p)}; }
+    static Avx2Pack broadcast(double x) { return Avx2Pack{_mm256_set1_pd(x)}; }
+    static Avx2Pack floor(const Avx2Pack &a) { return Avx2Pack{_mm256_floor_pd(a.v)}; }
+    void store(double *p) const { _mm256_storeu_pd(p, v); }
+
+    Avx2Pack operator+(const Avx2Pack &b) const { return Avx2Pack{_mm256_add_pd(v, b.v)}; }
+    Avx2Pack operator-(const Avx2Pack &b) const { return Avx2Pack{_mm256_sub_pd(v, b.v)}; }
+    Avx2Pack operator*(const Avx2Pack &b) const { return Avx2Pack{_mm256_mul_pd(v, b.v)}; }
+};
+}
+
+int ur5_batch_fk::forwardAvx2(const UR5BatchFKParameters &p, const double *const q[6], int n, double *const position[3], double *const rotation[9])
+{
+    int end = n - n % Avx2Pack::WIDTH;
+    forward<Avx2Pack>(p, q, 0, end, position, rotation);
+    return end;
+}
+
+bool ur5_batch_fk::avx2Built() { return true; }
+
+#else
+
+int ur5_batch_fk::forwardAvx2(const UR5BatchFKParameters &, const double *const[6], int, double *const[3], double *const[9]) { return 0; }
+
+bool ur5_batch_fk::avx2Built() { return false; }
+
+#endif
@@ -0,0 +1,43 @@
+// Built with -mavx512f, called only after UR5BatchFK checked the CPU
+#include "ur5_batch_fk_kernel.hpp"
+
+#ifdef __AVX512F__
+#include <immintrin.h>
+
+namespace
+{
+struct Avx512Pack
+{
+    enum
+    {
+        WIDTH = 8
+    };
+    __m512d v;
+
+    static Avx512Pack load(const double *p) { return Avx512Pack{_mm512_loadu_pd(p)}; }
+    static Avx512Pack broadcast(double x) { return Avx512Pack{_mm512_set1_pd(x)}; }
+    static Avx512Pack floor(const Avx512Pack &a) { return Avx512Pack{_mm512_roundscale_pd(a.v, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC)}; }
+    void store(double *p) const { _mm512_storeu_pd(p, v); }
+
+    Avx512Pack operator+(const Avx512Pack &b) const { return Avx512Pack{_mm512_add_pd(v, b.v)}; }
+    Avx512Pack operator-(const Avx512Pack &b) const { return Avx512Pack{_mm512_sub_pd(v, b.v)}; }
+    Avx512Pack operator*(const Avx512Pack &b) const { return Avx512Pack{_mm512_mul_pd(v, b.v)}; }
+};
+}
+
+int ur5_batch_fk::forwardAvx512(const UR5BatchFKParameters &p, const double *const q[6], int n, double *const position[3], double *const rotation[9])
+{
+    int end = n - n % Avx512Pack::WIDTH;
+    forward<Avx512Pack>(p, q, 0, end, position, rotation);
+    return end;
+}
+
+bool ur5_batch_fk::avx512Built() { return true; }
+
+#else
+
+int ur5_batch_fk::forwardAvx512(const UR5BatchFKParameters &, const double *const[6], int, double *const[3], double *const[9]) { return 0; }
+
+bool ur5_batch_fk::avx512Built() { return false; }
+
+#endif
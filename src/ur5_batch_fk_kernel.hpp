@@ -0,0 +1,114 @@
+#ifndef UR5_BATCH_FK_KERNEL
+#define UR5_BATCH_FK_KERNEL
+
+// Batched UR5 forward kinematics written once for any pack of doubles, included only by the translation
+// units of UR5BatchFK, each one compiled for its own instruction set with its own pack type.
+// A pack P provides WIDTH, load, store, broadcast, floor and the + - * operators.
+// Everything here is a template, plain data or a declaration, so no function is shared between translation
+// units built with different flags
+
+#define _USE_MATH_DEFINES // For PI costants
+#include <cmath>
+
+// DH chain of the UR5 between its mounting frames, as plain arrays for the kernels
+struct UR5BatchFKParameters
+{
+    double a[6], d[6];
+    double sinAlpha[6], cosAlpha[6];
+    double base[12]; // 3x4 row major, rotation and translation
+    double tool[12];
+};
+
+namespace ur5_batch_fk
+{
+// Cody-Waite split of pi/2 and the sine and cosine polynomials on [-pi/4, pi/4], from Cephes
+const double PIO2_1 = 1.57079625129699707031e+00;
+const double PIO2_2 = 7.54978941586159635335e-08;
+const double PIO2_3 = 5.39030285815811905290e-15;
+const double SIN_COEFFICIENTS[6] = {1.58962301576546568060e-10, -2.50507477628578072866e-8, 2.75573136213857245213e-6,
+                                    -1.98412698295895385996e-4, 8.33333333332211858878e-3, -1.66666666666666307295e-1};
+const double COS_COEFFICIENTS[6] = {-1.13585365213876817300e-11, 2.08757008419747316778e-9, -2.75573141792967388112e-7,
+                                    2.48015872888517045348e-5, -1.38888888888730564116e-3, 4.16666666666665929218e-2};
+
+template <class P>
+P polynomial(const P &z, const double coefficients[6])
+{
+    P y = P::broadcast(coefficients[0]);
+    for (int i = 1; i < 6; i++)
+        y = y * z + P::broadcast(coefficients[i]);
+    return y;
+}
+
+// Sine and cosine of every lane: x = k pi/2 + r, then the quadrant k mod 4 = 2h + o picks and signs the
+// polynomials of r without branches
+template <class P>
+void sincos(const P &x, P &s, P &c)
+{
+    P k = P::floor(x * P::broadcast(2 / M_PI) + P::broadcast(0.5));
+    P r = ((x - k * P::broadcast(PIO2_1)) - k * P::broadcast(PIO2_2)) - k * P::broadcast(PIO2_3);
+    P z = r * r;
+    P sr = r + r * z * polynomial(z, SIN_COEFFICIENTS);
+    P cr = P::broadcast(1) - P::broadcast(0.5) * z + z * z * polynomial(z, COS_COEFFICIENTS);
+
+    P h = P::floor(k * P::broadcast(0.5));
+    P o = k - h * P::broadcast(2);
+    P sign = P::broadcast(1) - P::broadcast(2) * (h - P::floor(h * P::broadcast(0.5)) * P::broadcast(2));
+    s = sign * (sr + o * (cr - sr));
+    c = sign * (cr - o * (sr + cr));
+}
+
+// Configurations [begin, end) of the structure of arrays q[joint][i], end - begin a multiple of P::WIDTH;
+// tool positions go in position[axis][i] and rotations, row major, in rotation[row * 3 + column][i]
+template <class P>
+void forward(const UR5BatchFKParameters &p, const double *const q[6], int begin, int end, double *const position[3], double *const rotation[9])
+{
+    for (int i = begin; i + P::WIDTH <= end; i += P::WIDTH)
+    {
+        P T[3][4];
+        for (int r = 0; r < 3; r++)
+            for (int k = 0; k < 4; k++)
+                T[r][k] = P::broadcast(p.base[r * 4 + k]);
+
+        // T = T * A(q_j) row by row, A being the DH transform of joint j
+        for (int j = 0; j < 6; j++)
+        {
+            P s, c;
+            sincos(P::load(q[j] + i), s, c);
+            P sa = P::broadcast(p.sinAlpha[j]), ca = P::broadcast(p.cosAlpha[j]);
+            P a = P::broadcast(p.a[j]), d = P::broadcast(p.d[j]);
+            for (int r = 0; r < 3; r++)
+            {
+                P u = T[r][0] * c + T[r][1] * s;
+                P v = T[r][1] * c - T[r][0] * s;
+                P t2 = T[r][2];
+                T[r][0] = u;
+                T[r][1] = v * ca + t2 * sa;
+                T[r][2] = t2 * ca - v * sa;
+                T[r][3] = T[r][3] + u * a + t2 * d;
+            }
+        }
+
+        // Tool frame
+        for (int r = 0; r < 3; r++)
+        {
+            P pr = T[r][3];
+            for (int k = 0; k < 3; k++)
+            {
+                P value = T[r][0] * P::broadcast(p.tool[k]) + T[r][1] * P::broadcast(p.tool[4 + k]) + T[r][2] * P::broadcast(p.tool[8 + k]);
+                value.store(rotation[r * 3 + k] + i);
+                pr = pr + T[r][k] * P::broadcast(p.tool[k * 4 + 3]);
+            }
+            pr.store(position[r] + i);
+        }
+    }
+}
+
+// Entry points of the instruction set translation units: they evaluate the full packs of [0, n) and return
+// how many configurations they did, 0 when the unit was built without its instruction set
+int forwardAvx2(const UR5BatchFKParameters &p, const double *const q[6], int n, double *const position[3], double *const rotation[9]);
+int forwardAvx512(const UR5BatchFKParameters &p, const double *const q[6], int n, double *const position[3], double *const rotation[9]);
+bool avx2Built();
+bool avx512Built();
+}
+
+#endif
@@ -0,0 +1,186 @@
+#include "ur5_kinematics.hpp"
+
+#define _USE_MATH_DEFINES // For PI costants
+#include <cmath>
+
+// Twist angles of the DH convention are multiples of pi/2, so their sine and cosine are exact
+static const double SIN_ALPHA[6] = {1, 0, 0, 1, -1, 0};
+static const double COS_ALPHA[6] = {0, 1, 1, 0, 0, 1};
+
+// Below this value sin(q5) makes the wrist singular and q6 is free
+static const double WRIST_SINGULARITY = 1e-9;
+
+const double UR5Kinematics::JOINT_RANGE = 2 * M_PI;
+
+static double wrapAngle(double angle)
+{
+    angle = std::fmod(angle + M_PI, 2 * M_PI);
+    if (angle <= 0)
+        angle += 2 * M_PI;
+    return angle - M_PI;
+}
+
+// Constructor
+UR5Kinematics::UR5Kinematics()
+    : d1(0.089159), a2(-0.42500), a3(-0.39225), d4(0.10915), d5(0.09465), d6(0.0823)
+{
+    setMounting(Eigen::Isometry3d::Identity(), Eigen::Isometry3d::Identity());
+}
+
+void UR5Kinematics::setMounting(const Eigen::Isometry3d &base, const Eigen::Isometry3d &tool)
+{
+    this->base = base;
+    this->tool = tool;
+    this->baseInv = base.inverse();
+    this->toolInv = tool.inverse();
+}
+
+// Homogeneous transform of a single DH link
+Eigen::Matrix4d UR5Kinematics::dhTransform(int joint, double q) const
+{
+    const double a[6] = {0, a2, a3, 0, 0, 0};
+    const double d[6] = {d1, 0, 0, d4, d5, d6};
+    double c = cos(q), s = sin(q);
+    double ca = COS_ALPHA[joint], sa = SIN_ALPHA[joint];
+
+    Eigen::Matrix4d A;
+    A << c, -s * ca, s * sa, a[joint] * c,
+        s, c * ca, -c * sa, a[joint] * s,
+        0, sa, ca, d[joint],
+        0, 0, 0, 1;
+    return A;
+}
+
+Eigen::Isometry3d UR5Kinematics::forwardDH(const double q[6]) const
+{
+    Eigen::Matrix4d T = dhTransform(0, q[0]);
+    for (int i = 1; i < 6; i++)
+        T = T * dhTransform(i, q[i]);
+
+    Eigen::Isometry3d pose;
+    pose.matrix() = T;
+    return pose;
+}
+
+Eigen::Isometry3d UR5Kinematics::forward(const double q[6]) const
+{
+    return base * forwardDH(q) * tool;
+}
+
+int UR5Kinematics::inverse(const Eigen::Isometry3d &pose, double solutions[8][6], double q6Default) const
+{
+    const Eigen::Matrix4d T = (baseInv * pose * toolInv).matrix();
+    int n = 0;
+
+    // Shoulder pan: the wrist center must lie at distance d4 from the plane of the arm
+    Eigen::Vector3d p05 = T.block<3, 1>(0, 3) - d6 * T.block<3, 1>(0, 2);
+    double r = std::hypot(p05.x(), p05.y());
+    if (r < std::fabs(d4))
+        return 0;
+    double psi = atan2(p05.y(), p05.x());
+    double phi = asin(d4 / r);
+    double q1s[2] = {psi + phi, psi + M_PI - phi};
+
+    for (int i = 0; i < 2; i++)
+    {
+        double q1 = q1s[i];
+        double s1 = sin(q1), c1 = cos(q1);
+
+        // Wrist 2, from the height of the flange over the arm plane
+        double c5 = (T(0, 3) * s1 - T(1, 3) * c1 - d4) / d6;
+        if (std::fabs(c5) > 1)
+        {
+            if (std::fabs(c5) > 1 + 1e-9)
+                continue;
+            c5 = c5 > 0 ? 1 : -1;
+        }
+        double q5a = acos(c5);
+        double q5s[2] = {q5a, -q5a};
+
+        for (int j = 0; j < 2; j++)
+        {
+            double q5 = q5s[j];
+            double s5 = sin(q5);
+
+            // Wrist 3
+            double q6 = q6Default;
+            if (std::fabs(s5) > WRIST_SINGULARITY)
+                q6 = atan2((-T(0, 1) * s1 + T(1, 1) * c1) / s5, (T(0, 0) * s1 - T(1, 0) * c1) / s5);
+
+            // Shoulder lift, elbow and wrist 1 form a planar 3R arm in the frame of link 1
+            Eigen::Matrix4d T14 = dhTransform(0, q1).inverse() * T * dhTransform(5, q6).inverse() * dhTransform(4, q5).inverse();
+            double x = T14(0, 3), y = T14(1, 3);
+            double c3 = (x * x + y * y - a2 * a2 - a3 * a3) / (2 * a2 * a3);
+            if (std::fabs(c3) > 1)
+            {
+                if (std::fabs(c3) > 1 + 1e-9)
+                    continue;
+                c3 = c3 > 0 ? 1 : -1;
+            }
+            double q3a = acos(c3);
+            double q3s[2] = {q3a, -q3a};
+
+            for (int k = 0; k < 2; k++)
+            {
+                double q3 = q3s[k];
+                double q2 = atan2(y, x) - atan2(a3 * sin(q3), a2 + a3 * cos(q3));
+                double q4 = atan2(T14(1, 0), T14(0, 0)) - q2 - q3;
+
+                double *q = solutions[n++];
+                q[0] = wrapAngle(q1);
+                q[1] = wrapAngle(q2);
+                q[2] = wrapAngle(q3);
+                q[3] = wrapAngle(q4);
+                q[4] = wrapAngle(q5);
+                q[5] = wrapAngle(q6);
+            }
+        }
+    }
+    return n;
+}
+
+bool UR5Kinematics::closestSolution(const Eigen::Isometry3d &pose, const double seed[6], double q[6]) const
+{
+    double solutions[8][6];
+    int n = inverse(pose, solutions, seed[5]);
+
+    int best = -1;
+    double bestDistance = 0;
+    for (int i = 0; i < n; i++)
+    {
+        double distance = 0;
+        for (int j = 0; j < 6; j++)
+        {
+            double delta = wrapAngle(solutions[i][j] - seed[j]);
+            distance += delta * delta;
+        }
+        if (best < 0 || distance < bestDistance)
+        {
+            best = i;
+            bestDistance = distance;
+        }
+    }
+    if (best < 0)
+        return false;
+
+    // Keep each joint on the turn of its seed, so that consecutive samples do not jump by 2*pi,
+    // unless that turn is out of the joint range
+    for (int j = 0; j < 6; j++)
+    {
+        q[j] = seed[j] + wrapAngle(solutions[best][j] - seed[j]);
+        if (std::abs(q[j]) > JOINT_RANGE)
+            q[j] = solutions[best][j];
+    }
+    return true;
+}
+
+// GETTERS
+
+double UR5Kinematics::getD1() const { return d1; }
+double UR5Kinematics::getA2() const { return a2; }
+double UR5Kinematics::getA3() const { return a3; }
+double UR5Kinematics::getD4() const { return d4; }
+double UR5Kinematics::getD5() const { return d5; }
+double UR5Kinematics::getD6() const { return d6; }
+const Eigen::Isometry3d &UR5Kinematics::getBase() const { return base; }
+const Eigen::Isometry3d &UR5Kinematics::getTool() const { return tool; }
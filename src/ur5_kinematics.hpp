@@ -0,0 +1,53 @@
+#ifndef UR5_KINEMATICS
+#define UR5_KINEMATICS
+
+#include <Eigen/Eigen>
+#include <Eigen/Dense>
+#include <Eigen/Geometry>
+
+//CLASS FOR THE CLOSED FORM KINEMATICS OF THE UR5
+//joints are in chain order (shoulder pan, shoulder lift, elbow, wrist 1, wrist 2, wrist 3)
+class UR5Kinematics
+{
+private:
+    // Denavit-Hartenberg parameters of the UR5
+    double d1, a2, a3, d4, d5, d6;
+
+    // Fixed frames before the first and after the last joint: the arm pose is base * DH(q) * tool
+    Eigen::Isometry3d base, tool;
+    Eigen::Isometry3d baseInv, toolInv;
+
+    Eigen::Matrix4d dhTransform(int joint, double q) const;
+
+public:
+    // [rad] every joint of the UR5 turns within +-JOINT_RANGE
+    static const double JOINT_RANGE;
+
+    // Constructor
+    UR5Kinematics();
+
+    void setMounting(const Eigen::Isometry3d &base, const Eigen::Isometry3d &tool);
+
+    // Pose of the DH flange frame in the DH base frame, without mounting frames
+    Eigen::Isometry3d forwardDH(const double q[6]) const;
+    Eigen::Isometry3d forward(const double q[6]) const;
+
+    // All the solutions reaching the pose, angles in (-pi, pi]. Returns how many were found (at most 8)
+    int inverse(const Eigen::Isometry3d &pose, double solutions[8][6], double q6Default = 0.0) const;
+
+    // Solution on the branch closest to the seed, each joint as close as possible to its seed value within
+    // +-JOINT_RANGE
+    bool closestSolution(const Eigen::Isometry3d &pose, const double seed[6], double q[6]) const;
+
+    // Getters
+    double getD1() const;
+    double getA2() const;
+    double getA3() const;
+    double getD4() const;
+    double getD5() const;
+    double getD6() const;
+    const Eigen::Isometry3d &getBase() const;
+    const Eigen::Isometry3d &getTool() const;
+};
+
+#endif